@@ -4,9 +4,14 @@
 #include "mdk.h"
 
 extern int main(void);
-extern char _sbss, _ebss, _end, _eram;
+extern char _sbss, _ebss, _end, _eram, _epsram, _srtc, _ertc;
 
 static char *s_heap_start, *s_heap_end, *s_brk;
+static struct heap s_psram_heap;  // PSRAM after the .psram section
+static size_t s_psram_size;
+
+// Written before .bss is cleared, so it lives in .data
+uint32_t boot_times[BOOT_PHASES] __attribute__((section(".data")));
 
 void *sbrk(int diff) {
   char *old = s_brk;
@@ -15,10 +20,54 @@ void *sbrk(int diff) {
   return old;
 }
 
+#if MDK_FAST_MEM  // These take precedence over ROM functions in link.ld
+void *memcpy(void *dst, const void *src, size_t n) {
+  return mem_copy(dst, src, n);
+}
+
+void *memset(void *dst, int c, size_t n) {
+  return mem_fill(dst, c, n);
+}
+
+void *memmove(void *dst, const void *src, size_t n) {
+  return mem_move(dst, src, n);
+}
+
+int memcmp(const void *a, const void *b, size_t n) {
+  return mem_compare(a, b, n);
+}
+#endif
+
+void *psram_malloc(size_t size) {
+  return heap_alloc(&s_psram_heap, size);
+}
+
+void psram_free(void *ptr) {
+  heap_free(&s_psram_heap, ptr);
+}
+
+size_t psram_size(void) {
+  return s_psram_size;
+}
+
+// Unlike esp32c3 SYSTIMER, TIMG0 does not run from reset: start it here, so
+// BOOT_RESET is about 0 and BOOT_CLOCK measures the clock setup. Until then,
+// the timer runs from the 40 MHz XTAL, so that phase reads up to 2x short
 void _reset(void) {
+  REG(ESP32_TIMERGROUP0)[0] |= BIT(31);  // Enable TIMG0
+  boot_times[BOOT_RESET] = (uint32_t) uptime_us();
+  soc_init();  // Raise the clock first, so the rest of the boot runs faster
+  boot_times[BOOT_CLOCK] = (uint32_t) uptime_us();
+  mem_fill(&_sbss, 0, (size_t) (&_ebss - &_sbss));
+  if (!boot_warm()) mem_fill(&_srtc, 0, (size_t) (&_ertc - &_srtc));
+  boot_times[BOOT_BSS] = (uint32_t) uptime_us();
   s_heap_start = s_brk = &_end, s_heap_end = &_eram;
-  for (char *p = &_sbss; p < &_ebss;) *p++ = '\0';
-  soc_init();
+  s_psram_size = MDK_PSRAM ? psram_init() : 0;  // Touches GPIO16, GPIO17
+  if (s_psram_size > (size_t) (&_epsram - (char *) PSRAM_START)) {
+    size_t free = s_psram_size - (size_t) (&_epsram - (char *) PSRAM_START);
+    heap_init(&s_psram_heap, &_epsram, free);  // Rest of PSRAM is the heap
+  }
+  boot_times[BOOT_INIT] = (uint32_t) uptime_us();
   main();
   for (;;) (void) 0;
 }
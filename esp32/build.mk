@@ -10,15 +10,36 @@ CFLAGS      ?= -W -Wall -Wextra -Werror -Wundef -Wshadow -pedantic \
 LINKFLAGS   ?= -T$(MDK)/$(ARCH)/link.ld -nostdlib -nostartfiles -Wl,--gc-sections $(EXTRA_LINKFLAGS)
 CWD         ?= $(realpath $(CURDIR))
 FLASH_ADDR  ?= 0x1000  # 2nd stage bootloader flash offset
-DOCKER      ?= docker run -it --rm -v $(CWD):$(CWD) -v $(MDK):$(MDK) -w $(CWD) espressif/idf
-TOOLCHAIN   ?= $(DOCKER) xtensa-esp32-elf
+DOCKER      ?= docker run --rm -v $(CWD):$(CWD) -v $(MDK):$(MDK) -w $(CWD) espressif/idf
+PREFIX      ?= xtensa-esp32-elf
+LOCAL_GCC   := $(shell command -v $(PREFIX)-gcc)
+TOOLCHAIN   ?= $(if $(LOCAL_GCC),,$(DOCKER) )$(PREFIX)
+CCACHE      ?=  # Set to ccache to use it with a local toolchain
 SRCS        ?= $(MDK)/$(ARCH)/boot.c $(SOURCES)
+OBJDIR      ?= $(PROG)-$(ARCH)
+OBJS        ?= $(patsubst %.c,$(OBJDIR)%.o,$(abspath $(SRCS)))
+SIZETOOL    ?= $(MDK)/tools/sizereport
+SIZE_BUDGET ?=
+SIZE_TOP    ?= 10
+QEMU        ?= qemu-system-xtensa -nographic -machine esp32
 
-build: $(PROG).bin
+build: $(PROG).bin $(if $(SIZE_BUDGET),size)
 
-$(PROG).elf: $(SRCS)
-	$(TOOLCHAIN)-gcc  $(CFLAGS) $(SRCS) $(LINKFLAGS) -o $@
-#	$(TOOLCHAIN)-size $@
+# Objects mirror absolute source paths under OBJDIR. -MMD tracks headers,
+# the flags file tracks CFLAGS: changing e.g. -DMDK_FAST_MEM rebuilds all
+$(OBJDIR)/%.o: /%.c $(OBJDIR)/cflags
+	@mkdir -p $(dir $@)
+	$(CCACHE) $(TOOLCHAIN)-gcc $(CFLAGS) -MMD -MP -c $< -o $@
+
+# Keep the previous map, for make size to show what changed
+$(PROG).elf: $(OBJS)
+	@test ! -f $(PROG).map || cp $(PROG).map $(PROG).map.old
+	$(TOOLCHAIN)-gcc $(CFLAGS) $(OBJS) $(LINKFLAGS) -Wl,-Map=$(PROG).map -o $@
+
+# Memory footprint report. Fails if any of SIZE_BUDGET is exceeded
+size: $(PROG).elf $(SIZETOOL)
+	$(SIZETOOL) -n $(SIZE_TOP) $(addprefix -b ,$(SIZE_BUDGET)) \
+    $(if $(wildcard $(PROG).map.old),-p $(PROG).map.old) $(PROG).map
 
 $(PROG).bin: $(PROG).elf $(ESPUTIL)
 	$(ESPUTIL) mkbin $(PROG).elf $@
@@ -29,11 +50,32 @@ flash: $(PROG).bin $(ESPUTIL)
 monitor: $(ESPUTIL)
 	$(ESPUTIL) monitor
 
+# 4 MB flash image for QEMU, erased, with firmware at FLASH_ADDR
+$(PROG).img: $(PROG).bin
+	head -c 4194304 /dev/zero | tr '\000' '\377' > $@
+	dd if=$(PROG).bin of=$@ bs=4096 seek=$$(($(FLASH_ADDR) / 4096)) conv=notrunc
+
+# Run in Espressif's QEMU fork, when no board is attached
+qemu: $(PROG).img
+	$(QEMU) -drive file=$(PROG).img,if=mtd,format=raw
+
 $(MDK)/esputil/esputil.c:
 	git submodule update --init --recursive
 
 $(ESPUTIL): $(MDK)/esputil/esputil.c
 	make -C $(MDK)/esputil esputil
 
+$(SIZETOOL): $(MDK)/tools/sizereport.c
+	make -C $(MDK)/tools sizereport
+
 clean:
 	@rm -rf *.{bin,elf,map,lst,tgz,zip,hex} $(PROG)*
+
+# Rewritten only when CFLAGS differ from the previous build
+$(OBJDIR)/cflags: FORCE
+	@mkdir -p $(dir $@)
+	@echo '$(CFLAGS)' | cmp -s - $@ || echo '$(CFLAGS)' > $@
+
+FORCE:
+
+-include $(OBJS:.o=.d)
@@ -10,6 +10,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "../lib/bme280.h"
+#include "../lib/heap.h"
+#include "../lib/kv.h"
+#include "../lib/mem.h"
+#include "../lib/pwm.h"
+#include "../lib/ring.h"
+#include "../lib/ws2812.h"
+
 #define BIT(x) ((uint32_t) 1U << (x))
 #define REG(x) ((volatile uint32_t *) (x))
 
@@ -122,6 +130,40 @@ static inline void soc_init(void) {
   cpu_freq_240();
 }
 
+// API boot and deep sleep. boot.c raises the clock first, then clears .bss,
+// and records a timestamp after each phase in boot_times[], in microseconds
+enum { BOOT_RESET, BOOT_CLOCK, BOOT_BSS, BOOT_INIT, BOOT_PHASES };
+extern uint32_t boot_times[BOOT_PHASES];  // Implemented in boot.c
+
+// Variables in RTC fast memory keep their values in deep sleep. boot.c
+// zeroes them on any other reset, so they cannot have initialisers
+#define RTC_ATTR __attribute__((section(".rtc")))
+
+#define RTC_SLOW_KHZ 150  // RTC_CLK, internal 150 kHz RC, approximate
+
+// True if this boot is a wakeup from deep sleep. Skip reinitialising state
+// kept in RTC_ATTR variables, and peripherals that keep their configuration
+static inline bool boot_warm(void) {
+  return (REG(ESP32_RTCCNTL)[13] & 0x3f) == 5;  // PRO CPU: DEEPSLEEP_RESET
+}
+
+// Power down all but RTC, restart after `ms` milliseconds. TRM 31.3
+static inline void deep_sleep_ms(unsigned long ms) {
+  uint64_t t;
+  REG(ESP32_RTCCNTL)[3] = BIT(31);  // RTC_CNTL_TIME_UPDATE: latch RTC timer
+  while ((REG(ESP32_RTCCNTL)[3] & BIT(30)) == 0) spin(1);  // Wait valid
+  t = ((uint64_t) REG(ESP32_RTCCNTL)[5] << 32) | REG(ESP32_RTCCNTL)[4];
+  t += (uint64_t) ms * RTC_SLOW_KHZ;
+  REG(ESP32_RTCCNTL)[1] = (uint32_t) t;  // SLP_TIMER0, SLP_TIMER1: alarm
+  REG(ESP32_RTCCNTL)[2] = ((uint32_t) (t >> 32) & 0xffff) | BIT(16);
+  REG(ESP32_RTCCNTL)[17] = BIT(23);    // WAKEUP_STATE: wake up on timer
+  REG(ESP32_RTCCNTL)[32] &= ~BIT(14);  // PWC: keep RTC fast memory powered
+  REG(ESP32_RTCCNTL)[32] |= BIT(13);   // in deep sleep
+  REG(ESP32_RTCCNTL)[34] |= BIT(31);   // DIG_PWC: power down digital core
+  REG(ESP32_RTCCNTL)[0] |= BIT(31);    // STATE0: sleep now
+  for (;;) spin(1);
+}
+
 // API GPIO
 #define GPIO_FUNC_OUT_SEL_CFG_REG REG(0X3ff44530)  // Pins 0-39
 #define GPIO_FUNC_IN_SEL_CFG_REG REG(0X3ff44130)   // Pins 0-39
@@ -226,6 +268,326 @@ static inline void uart_write(int no, uint8_t c) {
   if (no == 0) (void) uart_tx_one_char(c);
 }
 
+// API flash, ROM SPI flash routines. Address, length and buffer must be
+// 4-byte aligned. Code runs from IRAM, so flash can be written at any time
+enum { FLASH_SECTOR_SIZE = 4096 };
+
+static inline bool flash_read(uint32_t addr, void *buf, size_t len) {
+  extern int esp_rom_spiflash_read(uint32_t, uint32_t *, int32_t);
+  return esp_rom_spiflash_read(addr, (uint32_t *) buf, (int32_t) len) == 0;
+}
+
+static inline void flash_unlock(void) {
+  extern int esp_rom_spiflash_unlock(void);
+  static bool unlocked;
+  if (!unlocked) (void) esp_rom_spiflash_unlock(), unlocked = true;
+}
+
+static inline bool flash_write(uint32_t addr, const void *buf, size_t len) {
+  extern int esp_rom_spiflash_write(uint32_t, const uint32_t *, int32_t);
+  flash_unlock();
+  return esp_rom_spiflash_write(addr, (const uint32_t *) buf,
+                                (int32_t) len) == 0;
+}
+
+// Erase sector that contains addr
+static inline bool flash_erase(uint32_t addr) {
+  extern int esp_rom_spiflash_erase_sector(uint32_t);
+  flash_unlock();
+  return esp_rom_spiflash_erase_sector(addr / FLASH_SECTOR_SIZE) == 0;
+}
+
+// API PSRAM, TRM 3.3.2, ESP-PSRAM32 datasheet. On WROVER modules, PSRAM
+// shares SPI0 data lines with flash, and uses CS1 on GPIO16 and CLK on
+// GPIO17. The cache maps it to 0x3f800000 in QPI mode at 40 MHz. Build with
+// -DMDK_PSRAM=1 for boot code to call psram_init(); then place buffers there
+// with PSRAM_ATTR, or allocate with psram_malloc(). Accessing PSRAM on a
+// module without it crashes
+#define PSRAM_ATTR __attribute__((section(".psram")))
+#define PSRAM_START 0x3f800000
+enum { PSRAM_MAX_SIZE = 4 * 1024 * 1024 };  // Mapped window, 128 x 32k pages
+
+extern void *psram_malloc(size_t size);  // Implemented in boot.c
+extern void psram_free(void *ptr);
+extern size_t psram_size(void);  // 0 if there is no PSRAM
+
+// Send a command to PSRAM via SPI1 in SPI mode, with optional 24-bit
+// address and `miso_bits` of response. Return the response
+static inline uint32_t psram_cmd(uint8_t cmd, bool addr, uint32_t miso_bits) {
+  REG(ESP32_SPI1)[7] = BIT(31) | (addr ? BIT(30) : 0) |  // SPI_USER_REG
+                       (miso_bits ? BIT(28) : 0);
+  REG(ESP32_SPI1)[8] = 23U << 26;                        // ADDR_BITLEN
+  REG(ESP32_SPI1)[9] = (7U << 28) | cmd;                 // 8-bit command
+  REG(ESP32_SPI1)[11] = miso_bits ? miso_bits - 1 : 0;   // SPI_MISO_DLEN_REG
+  REG(ESP32_SPI1)[1] = 0;                                // SPI_ADDR_REG
+  REG(ESP32_SPI1)[0] = BIT(18);                          // SPI_CMD_REG, USR
+  while (REG(ESP32_SPI1)[0] & BIT(18)) spin(1);
+  return REG(ESP32_SPI1)[32];  // SPI_W0_REG
+}
+
+// Reset PSRAM, check its ID, switch it to QPI mode and map it via the cache
+// of both CPUs. Return PSRAM size, or 0 if there is no PSRAM: then pins are
+// restored as they were
+static inline size_t psram_init(void) {
+  extern void Cache_Read_Disable(int cpu);
+  extern void Cache_Read_Enable(int cpu);
+  extern void Cache_Flush_rom(int cpu);
+  extern unsigned cache_sram_mmu_set_rom(int cpu, int pid, uint32_t vaddr,
+                                         uint32_t paddr, int psize, int num);
+  uint32_t ctrl = REG(ESP32_SPI1)[2], user = REG(ESP32_SPI1)[7];
+  uint32_t user1 = REG(ESP32_SPI1)[8], user2 = REG(ESP32_SPI1)[9], id;
+  size_t size;
+  volatile uint32_t *mux = REG(ESP32_IO_MUX);
+  uint8_t data_pins[] = {25, 26, 21, 22};  // IO_MUX of GPIO 7, 8, 9, 10
+  uint32_t saved[] = {mux[25], mux[26], mux[21], mux[22], mux[19], mux[20],
+                      GPIO_FUNC_OUT_SEL_CFG_REG[16],
+                      GPIO_FUNC_OUT_SEL_CFG_REG[17], GPIO_ENABLE_REG[0]};
+
+  for (size_t i = 0; i < sizeof(data_pins); i++) {
+    mux[data_pins[i]] = BIT(12) | BIT(9) | (2U << 10);  // SPI function, IE
+  }
+  mux[19] = (2U << 12) | (3U << 10);  // GPIO16 via GPIO matrix, strong drive
+  mux[20] = (2U << 12) | (3U << 10);  // GPIO17
+  GPIO_FUNC_OUT_SEL_CFG_REG[16] = 6;  // SPICS1_OUT
+  GPIO_FUNC_OUT_SEL_CFG_REG[17] = 0;  // SPICLK_OUT
+  gpio_output_enable(16, 1);
+  gpio_output_enable(17, 1);
+
+  // SPI1: SPI mode, talk to CS1 only, 40 MHz
+  REG(ESP32_SPI1)[2] = ctrl & ~(BIT(24) | BIT(23) | BIT(20) | BIT(14));
+  REG(ESP32_SPI1)[13] = BIT(0) | BIT(2);  // SPI_PIN_REG, CS0 and CS2 off
+  REG(ESP32_SPI1)[6] = (1U << 12) | 1U;   // SPI_CLOCK_REG, 80 MHz / 2
+  psram_cmd(0x66, false, 0);              // Reset enable
+  psram_cmd(0x99, false, 0);              // Reset
+  spin(1000);
+  id = psram_cmd(0x9f, true, 24);  // Read ID: MFID, KGD, EID
+  if (((id >> 8) & 0xff) == 0x5d) psram_cmd(0x35, false, 0);  // Enter QPI
+  REG(ESP32_SPI1)[13] = BIT(1) | BIT(2);  // Back to flash on CS0
+  REG(ESP32_SPI1)[2] = ctrl, REG(ESP32_SPI1)[7] = user;
+  REG(ESP32_SPI1)[8] = user1, REG(ESP32_SPI1)[9] = user2;
+  if (((id >> 8) & 0xff) != 0x5d) {  // KGD must be "pass"
+    for (size_t i = 0; i < sizeof(data_pins); i++) mux[data_pins[i]] = saved[i];
+    mux[19] = saved[4], mux[20] = saved[5];
+    GPIO_FUNC_OUT_SEL_CFG_REG[16] = saved[6];
+    GPIO_FUNC_OUT_SEL_CFG_REG[17] = saved[7];
+    gpio_output_enable(16, saved[8] & BIT(16));
+    gpio_output_enable(17, saved[8] & BIT(17));
+    return 0;
+  }
+
+  // EID bits 7:5: 0 - 16 Mbit, 1 - 32 Mbit, 2 - 64 Mbit
+  size = (size_t) (2 * 1024 * 1024) << ((id >> 21) & 7);
+  if (size > PSRAM_MAX_SIZE) size = PSRAM_MAX_SIZE;
+
+  // SPI0 cache access: QPI, read 0xeb with 6 + 1 dummy cycles, write 0x38
+  REG(ESP32_SPI0)[6] = (1U << 12) | 1U;  // SPI_CLOCK_REG, 80 MHz / 2
+  REG(ESP32_SPI0)[21] = BIT(28) | (23U << 22) | (6U << 14) | BIT(5) |
+                        BIT(4) | BIT(2);  // SPI_CACHE_SCTRL_REG
+  REG(ESP32_SPI0)[23] = (7U << 28) | 0xeb;  // SPI_SRAM_DRD_CMD_REG
+  REG(ESP32_SPI0)[24] = (7U << 28) | 0x38;  // SPI_SRAM_DWR_CMD_REG
+  REG(ESP32_SPI0)[13] &= ~BIT(1);           // SPI_PIN_REG, enable CS1
+
+  for (int cpu = 0; cpu < 2; cpu++) {
+    volatile uint32_t *cache = &REG(ESP32_DPORT)[cpu == 0 ? 16 : 22];
+    Cache_Read_Disable(cpu);
+    Cache_Flush_rom(cpu);
+    cache[0] &= ~(BIT(16) | BIT(11));  // CACHE_CTRL: DRAM_HL, DRAM_SPLIT off
+    cache[1] &= ~(BIT(3) | (7U << 6));  // CACHE_CTRL1: unmask DRAM1, 32k
+    cache_sram_mmu_set_rom(cpu, 0, PSRAM_START, 0, 32,
+                           (int) (size / 32768));
+    Cache_Read_Enable(cpu);
+  }
+  return size;
+}
+
+// API PWM, LEDC. TRM 14
+// 8 high speed channels, 4 high speed timers. Timers are clocked from 80 MHz
+// APB_CLK. Duty is in timer resolution units: 0 .. (1 << bits)
+enum { PWM_CHANNELS = 8, PWM_TIMERS = 4, PWM_SIG_OUT = 71 };
+
+static inline bool pwm_timer_init(int timer, uint32_t freq, int bits) {
+  uint32_t div;
+  if (timer < 0 || timer >= PWM_TIMERS || bits < 1 || bits > 20) return false;
+  if (freq == 0 || (div = pwm_div(80000000U, freq, (unsigned) bits)) == 0)
+    return false;
+  REG(ESP32_DPORT)[48] |= BIT(11);   // DPORT_PERIP_CLK_EN_REG, enable LEDC
+  REG(ESP32_DPORT)[49] &= ~BIT(11);  // DPORT_PERIP_RST_EN_REG, unreset
+  REG(ESP32_LEDC)[80 + timer * 2] = BIT(25) | (div << 5) | (uint32_t) bits;
+  return true;
+}
+
+static inline bool pwm_init(int ch, int timer, int pin) {
+  if (ch < 0 || ch >= PWM_CHANNELS || timer < 0 || timer >= PWM_TIMERS)
+    return false;
+  REG(ESP32_LEDC)[ch * 5 + 1] = 0;                      // HPOINT
+  REG(ESP32_LEDC)[ch * 5 + 2] = 0;                      // DUTY
+  REG(ESP32_LEDC)[ch * 5 + 3] = BIT(31);                // DUTY_START
+  REG(ESP32_LEDC)[ch * 5] = BIT(2) | (uint32_t) timer;  // Output on, timer
+  GPIO_FUNC_OUT_SEL_CFG_REG[pin] = BIT(10) | (uint32_t) (PWM_SIG_OUT + ch);
+  gpio_output_enable(pin, 1);
+  return true;
+}
+
+// High speed channels latch new duty at the next period
+static inline void pwm_set(int ch, uint32_t duty) {
+  if (ch < 0 || ch >= PWM_CHANNELS) return;
+  REG(ESP32_LEDC)[ch * 5 + 2] = duty << 4;  // 4 fractional bits
+  REG(ESP32_LEDC)[ch * 5 + 3] = BIT(31) | BIT(30) | BIT(20) | BIT(10);
+}
+
+static inline uint32_t pwm_get(int ch) {
+  if (ch < 0 || ch >= PWM_CHANNELS) return 0;
+  return REG(ESP32_LEDC)[ch * 5 + 4] >> 4;
+}
+
+// Set duties of several channels, driven by the same timer, at once.
+// Wait for the timer overflow, so all writes land in the same period
+static inline void pwm_set_many(const int *chs, const uint32_t *duties,
+                                int n) {
+  uint32_t ovf;
+  for (int i = 0; i < n; i++) {
+    if (chs[i] < 0 || chs[i] >= PWM_CHANNELS) return;
+  }
+  if (n <= 0) return;
+  ovf = BIT(REG(ESP32_LEDC)[chs[0] * 5] & 3);  // Timer of the first channel
+  REG(ESP32_LEDC)[99] = ovf;                   // LEDC_INT_CLR_REG
+  while ((REG(ESP32_LEDC)[96] & ovf) == 0) spin(1);  // LEDC_INT_RAW_REG
+  for (int i = 0; i < n; i++) pwm_set(chs[i], duties[i]);
+}
+
+// Ramp duty from the current value to `duty` over `periods` PWM periods.
+// Runs in hardware, pwm_fade_done() tells when it is finished. Hardware
+// ramps take 1 .. 1023 periods per step, so the actual length can differ:
+// return it, in periods
+static inline uint32_t pwm_fade(int ch, uint32_t duty, uint32_t periods) {
+  uint32_t from, num, scale, cycles, len, inc;
+  if (ch < 0 || ch >= PWM_CHANNELS) return 0;
+  len = pwm_fade_plan(pwm_get(ch), duty, periods, &from, &num, &scale, &cycles);
+  if (len == 0) {
+    pwm_set(ch, duty);  // Nothing to ramp. Applied at the next period
+    return 1;
+  }
+  inc = duty > from ? 1 : 0;
+  REG(ESP32_LEDC)[99] = BIT(8 + ch);  // Clear "fade done"
+  REG(ESP32_LEDC)[ch * 5 + 2] = from << 4;
+  REG(ESP32_LEDC)[ch * 5 + 3] =
+      BIT(31) | (inc << 30) | (num << 20) | (cycles << 10) | scale;
+  return len;
+}
+
+static inline bool pwm_fade_done(int ch) {
+  if (ch < 0 || ch >= PWM_CHANNELS) return false;
+  return REG(ESP32_LEDC)[96] & BIT(8 + ch) ? 1 : 0;
+}
+
+// API dual core
+// The APP CPU starts at fn(arg), on its own stack. Both cores run from IRAM.
+// Spinlocks use S32C1I, which works only on internal RAM
+
+struct cpu_boot {
+  void (*fn)(void *);  // APP CPU entry point
+  void *arg;           // Its argument
+  char *sp;            // Top of the APP CPU stack
+};
+
+static inline struct cpu_boot *cpu_boot_state(void) {
+  static struct cpu_boot boot;
+  return &boot;
+}
+
+// Return 0 on PRO CPU, 1 on APP CPU
+static inline int cpu_id(void) {
+  uint32_t prid;
+  asm volatile("rsr.prid %0" : "=r"(prid));
+  return prid & BIT(13) ? 1 : 0;  // 0xcdcd on PRO, 0xabab on APP
+}
+
+// ROM starts APP CPU here, on a ROM stack. Switch to our stack and call fn
+static inline void cpu_app_entry(void) {
+  struct cpu_boot *b = cpu_boot_state();
+  asm volatile("mov a6, %2\n"  // Argument for the windowed callx4
+               "mov a1, %0\n"  // Our stack
+               "callx4 %1\n"
+               :
+               : "r"(b->sp), "r"(b->fn), "r"(b->arg)
+               : "a6", "memory");
+  for (;;) asm volatile("waiti 0");
+}
+
+static inline bool cpu_start(void (*fn)(void *), void *arg, void *stack,
+                             size_t size) {
+  extern void ets_set_appcpu_boot_addr(uint32_t);
+  struct cpu_boot *b = cpu_boot_state();
+  if (REG(ESP32_DPORT)[12] & BIT(0)) return false;  // Already running
+  b->fn = fn, b->arg = arg;
+  b->sp = (char *) (((uintptr_t) stack + size) & ~(uintptr_t) 15);
+  asm volatile("memw" ::: "memory");
+  ets_set_appcpu_boot_addr((uint32_t) (uintptr_t) cpu_app_entry);
+  REG(ESP32_DPORT)[12] |= BIT(0);   // DPORT_APPCPU_CTRL_B_REG, clock on
+  REG(ESP32_DPORT)[13] &= ~BIT(0);  // DPORT_APPCPU_CTRL_C_REG, no stall
+  REG(ESP32_DPORT)[11] |= BIT(0);   // DPORT_APPCPU_CTRL_A_REG, reset
+  REG(ESP32_DPORT)[11] &= ~BIT(0);
+  return true;
+}
+
+// Atomically set *p to `val` if it is `expected`. Return true on success
+static inline bool cpu_cas(volatile uint32_t *p, uint32_t expected,
+                           uint32_t val) {
+  asm volatile("wsr %2, scompare1\n"
+               "s32c1i %0, %1, 0\n"
+               : "+r"(val)
+               : "r"(p), "r"(expected)
+               : "memory");
+  return val == expected;
+}
+
+struct spinlock {
+  volatile uint32_t owner;  // 0 when free, otherwise cpu_id() + 1
+};
+
+static inline bool spin_trylock(struct spinlock *l) {
+  return cpu_cas(&l->owner, 0, (uint32_t) cpu_id() + 1);
+}
+
+static inline void spin_lock(struct spinlock *l) {
+  while (!spin_trylock(l)) spin(1);
+}
+
+static inline void spin_unlock(struct spinlock *l) {
+  asm volatile("memw" ::: "memory");  // Flush writes done under the lock
+  l->owner = 0;
+}
+
+// Cross-core notifications, FROM_CPU_INTR0..3 interrupt sources. Raise one
+// from any core, wake up the core that attached a handler to it
+static inline void cpu_notify(int n) {
+  REG(ESP32_DPORT)[55 + n] = 1;  // DPORT_CPU_INTR_FROM_CPU_n_REG
+}
+
+static inline void cpu_notify_clear(int n) {
+  REG(ESP32_DPORT)[55 + n] = 0;
+}
+
+static inline bool cpu_notified(int n) {
+  return REG(ESP32_DPORT)[55 + n] & 1 ? 1 : 0;
+}
+
+// Route FROM_CPU_INTRn to the calling core as level 1 CPU interrupt 2 + n.
+// The handler must call cpu_notify_clear(n)
+static inline void cpu_notify_attach(int n, void (*fn)(void *), void *arg) {
+  extern void intr_matrix_set(int, uint32_t, uint32_t);
+  extern void ets_isr_attach(int, void (*)(void *), void *);
+  extern void ets_isr_unmask(uint32_t);
+  intr_matrix_set(cpu_id(), (uint32_t) (24 + n), (uint32_t) (2 + n));
+  ets_isr_attach(2 + n, fn, arg);
+  ets_isr_unmask(BIT(2 + n));
+}
+
+// Sleep until an interrupt, e.g. a notification from the other core
+static inline void cpu_wait(void) {
+  asm volatile("waiti 0" ::: "memory");
+}
+
 // API WS2812
 static inline void ws2812_show(int pin, const uint8_t *buf, size_t len) {
   unsigned long delays[2] = {2, 6};
@@ -240,6 +602,94 @@ static inline void ws2812_show(int pin, const uint8_t *buf, size_t len) {
   }
 }
 
+// API WS2812 parallel, I2S0 in LCD mode, TRM 12.5. Up to 16 strips.
+// Each bit is sent as 3 16-bit samples at 2.4 MHz: high, data, low, so that
+// sample bit N drives I2S0O_DATA_OUT(8 + N), routed to pins[N]. DMA streams
+// the samples from the scratch buffer while the CPU prepares the next frame
+enum { WS2812_MAX_STRIPS = 16, WS2812_SIG_OUT = 148 };  // I2S0O_DATA_OUT8
+enum { WS2812_RESET_SAMPLES = 720, WS2812_DMA_MAX = 4092 };  // 300 us reset
+#define WS2812_SAMPLES_SIZE(len) \
+  ((len) * 8 * 3 * sizeof(uint16_t) + WS2812_RESET_SAMPLES * sizeof(uint16_t))
+#define WS2812_SCRATCH_SIZE(len) \
+  (WS2812_SAMPLES_SIZE(len) +    \
+   (WS2812_SAMPLES_SIZE(len) / WS2812_DMA_MAX + 1) * sizeof(struct i2s_dma))
+
+struct i2s_dma {
+  uint32_t ctrl;         // Owner, EOF, length, size. TRM 12.4.9
+  const void *buf;       // Data
+  struct i2s_dma *next;  // Next descriptor, or NULL
+};
+
+static inline bool ws2812_parallel_init(const int *pins, int n) {
+  if (n < 1 || n > WS2812_MAX_STRIPS) return false;
+  REG(ESP32_DPORT)[48] |= BIT(4);   // DPORT_PERIP_CLK_EN_REG, enable I2S0
+  REG(ESP32_DPORT)[49] &= ~BIT(4);  // DPORT_PERIP_RST_EN_REG, unreset
+  REG(ESP32_I2S)[2] = BIT(0) | BIT(2);             // Reset TX and TX FIFO
+  REG(ESP32_I2S)[2] = 0;                           // I2S_CONF_REG
+  REG(ESP32_I2S)[24] = BIT(1) | BIT(2) | BIT(3);   // Reset DMA
+  REG(ESP32_I2S)[24] = BIT(8) | BIT(9) | BIT(11);  // EOF when FIFO is empty
+  REG(ESP32_I2S)[42] = BIT(5);                     // I2S_CONF2_REG: LCD_EN
+  REG(ESP32_I2S)[40] = BIT(3);                     // I2S_CONF1: PCM bypass
+  REG(ESP32_I2S)[7] = 0;                           // I2S_TIMING_REG
+  REG(ESP32_I2S)[11] = 1;                          // I2S_CONF_CHAN_REG
+  // I2S_FIFO_CONF_REG: force FIFO mode, 16-bit single channel, DMA
+  REG(ESP32_I2S)[8] = BIT(19) | BIT(13) | BIT(12) | (32U << 6);
+  // LCD sample rate: 160 MHz / 2 / (33 + 1/3) = 2.4 MHz
+  REG(ESP32_I2S)[43] = BIT(20) | (3U << 14) | (1U << 8) | 33U;
+  REG(ESP32_I2S)[44] = (16U << 12) | 1U;  // 16 bit samples, BCK divider 1
+  for (int s = 0; s < n; s++) {
+    uint32_t sig = (uint32_t) (WS2812_SIG_OUT + s);
+    GPIO_FUNC_OUT_SEL_CFG_REG[pins[s]] = BIT(10) | sig;  // Route data line
+    gpio_output_enable(pins[s], 1);
+  }
+  return true;
+}
+
+// Wait until the previous frame is fully sent
+static inline void ws2812_parallel_wait(void) {
+  if ((REG(ESP32_I2S)[2] & BIT(4)) == 0) return;       // TX is not started
+  while ((REG(ESP32_I2S)[3] & BIT(16)) == 0) spin(1);  // I2S_OUT_TOTAL_EOF
+  delay_us(30);                  // Let the FIFO drain, 64 samples
+  REG(ESP32_I2S)[2] &= ~BIT(4);  // Stop TX
+}
+
+// Start sending `len` bytes of each of `n` strips at once, and return
+// without waiting. `scratch` must be WS2812_SCRATCH_SIZE(len) bytes in DRAM,
+// 4-byte aligned, and kept intact until the next call
+static inline void ws2812_parallel_show(const int *pins, int n,
+                                        const uint8_t *const *bufs,
+                                        size_t len, void *scratch) {
+  uint16_t *samples = (uint16_t *) scratch, planes[8];
+  size_t size = WS2812_SAMPLES_SIZE(len), i;
+  struct i2s_dma *dma = (struct i2s_dma *) ((char *) scratch + size);
+  (void) pins;  // Routed by ws2812_parallel_init()
+  ws2812_parallel_wait();
+  for (i = 0; i < len; i++) {
+    ws2812_transpose(planes, bufs, n, i);
+    for (size_t k = 0; k < 8; k++) {
+      size_t j = (i * 8 + k) * 3;
+      // The FIFO sends 16-bit halves of each 32-bit word swapped
+      samples[j ^ 1] = 0xffff, samples[(j + 1) ^ 1] = planes[k];
+      samples[(j + 2) ^ 1] = 0;
+    }
+  }
+  memset(&samples[len * 8 * 3], 0, WS2812_RESET_SAMPLES * sizeof(uint16_t));
+  for (i = 0; i * WS2812_DMA_MAX < size; i++) {
+    size_t off = i * WS2812_DMA_MAX;
+    uint32_t chunk = (uint32_t) (size - off > WS2812_DMA_MAX ? WS2812_DMA_MAX
+                                                              : size - off);
+    dma[i].ctrl = BIT(31) | (chunk << 12) | chunk;  // Owned by DMA
+    dma[i].buf = (char *) scratch + off;
+    dma[i].next = &dma[i + 1];
+  }
+  dma[i - 1].ctrl |= BIT(30), dma[i - 1].next = NULL;  // Last one, EOF
+  REG(ESP32_I2S)[2] |= BIT(0) | BIT(2);                // Reset TX and FIFO
+  REG(ESP32_I2S)[2] &= ~(BIT(0) | BIT(2));
+  REG(ESP32_I2S)[6] = 0xffffffff;  // I2S_INT_CLR_REG
+  REG(ESP32_I2S)[12] = BIT(29) | ((uint32_t) (uintptr_t) dma & 0xfffff);
+  REG(ESP32_I2S)[2] |= BIT(4);  // TX_START
+}
+
 // Default settings for board peripherals
 
 #ifndef LED1
@@ -249,3 +699,11 @@ static inline void ws2812_show(int pin, const uint8_t *buf, size_t len) {
 #ifndef BTN1
 #define BTN1 9  // Default user button pin
 #endif
+
+#ifndef MDK_FAST_MEM
+#define MDK_FAST_MEM 0  // 1: use lib/mem.h instead of ROM memcpy() & co
+#endif
+
+#ifndef MDK_PSRAM
+#define MDK_PSRAM 0  // 1: boot code calls psram_init()
+#endif
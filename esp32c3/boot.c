@@ -4,10 +4,13 @@
 #include "mdk.h"
 
 extern int main(void);
-extern char _sbss, _ebss, _end, _eram;
+extern char _sbss, _ebss, _end, _eram, _srtc, _ertc;
 
 static char *s_heap_start, *s_heap_end, *s_brk;
 
+// Written before .bss is cleared, so it lives in .data
+uint32_t boot_times[BOOT_PHASES] __attribute__((section(".data")));
+
 void *sbrk(int diff) {
   char *old = s_brk;
   if (&s_brk[diff] > s_heap_end) return NULL;
@@ -15,10 +18,78 @@ void *sbrk(int diff) {
   return old;
 }
 
+#if MDK_FAST_MEM  // These take precedence over ROM functions in link.ld
+void *memcpy(void *dst, const void *src, size_t n) {
+  return mem_copy(dst, src, n);
+}
+
+void *memset(void *dst, int c, size_t n) {
+  return mem_fill(dst, c, n);
+}
+
+void *memmove(void *dst, const void *src, size_t n) {
+  return mem_move(dst, src, n);
+}
+
+int memcmp(const void *a, const void *b, size_t n) {
+  return mem_compare(a, b, n);
+}
+#endif
+
+struct irq_handler irq_handlers[32];
+
+extern int uart_tx_one_char(int);  // ROM putchar
+
+// Print "name=xxxxxxxx" without printf, so it is safe in trap context
+static void trap_dump(const char *name, uint32_t value) {
+  while (*name != '\0') uart_tx_one_char(*name++);
+  uart_tx_one_char('=');
+  for (int i = 28; i >= 0; i -= 4)
+    uart_tx_one_char("0123456789abcdef"[(value >> i) & 15]);
+}
+
+// Machine trap handler in vectored mode, mtvec points to irq_vectors
+__attribute__((interrupt)) void irq_dispatch(void) {
+  uint32_t cause, epc, tval;
+  asm volatile("csrr %0, mcause" : "=r"(cause));
+  if (cause & BIT(31)) {
+    struct irq_handler *h = &irq_handlers[cause & 31];
+    if (h->fn != NULL) h->fn(h->arg);
+  } else {  // Exception. Dump registers and halt, no printf in here
+    asm volatile("csrr %0, mepc" : "=r"(epc));
+    asm volatile("csrr %0, mtval" : "=r"(tval));
+    trap_dump("\nEXCEPTION mcause", cause);
+    trap_dump(" mepc", epc);
+    trap_dump(" mtval", tval);
+    uart_tx_one_char('\n');
+    for (;;) (void) 0;
+  }
+}
+
+// Vector table: 256-byte aligned, a 4-byte jump per CPU interrupt
+asm(".section .text.irq_vectors, \"ax\"\n"
+    ".balign 256\n"
+    ".global irq_vectors\n"
+    "irq_vectors:\n"
+    ".option push\n"
+    ".option norvc\n"
+    ".rept 32\n"
+    "j irq_dispatch\n"
+    ".endr\n"
+    ".option pop\n"
+    ".previous\n");
+extern char irq_vectors[];
+
 void _reset(void) {
+  boot_times[BOOT_RESET] = (uint32_t) uptime_us();  // SYSTIMER runs from reset
+  soc_init();  // Raise the clock first, so the rest of the boot runs faster
+  boot_times[BOOT_CLOCK] = (uint32_t) uptime_us();
+  mem_fill(&_sbss, 0, (size_t) (&_ebss - &_sbss));
+  if (!boot_warm()) mem_fill(&_srtc, 0, (size_t) (&_ertc - &_srtc));
+  boot_times[BOOT_BSS] = (uint32_t) uptime_us();
   s_heap_start = s_brk = &_end, s_heap_end = &_eram;
-  for (char *p = &_sbss; p < &_ebss;) *p++ = '\0';
-  soc_init();
+  asm volatile("csrw mtvec, %0" : : "r"((uintptr_t) irq_vectors | 1));
+  boot_times[BOOT_INIT] = (uint32_t) uptime_us();
   main();
   for (;;) (void) 0;
 }
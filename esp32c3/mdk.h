@@ -10,8 +10,18 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "../lib/bme280.h"
+#include "../lib/heap.h"
+#include "../lib/kv.h"
+#include "../lib/mem.h"
+#include "../lib/pwm.h"
+#include "../lib/ring.h"
+#include "../lib/ws2812.h"
+
 #define BIT(x) ((uint32_t) 1U << (x))
+#ifndef REG  // Host build defines its own, see host/mdk.h
 #define REG(x) ((volatile uint32_t *) (x))
+#endif
 
 #define C3_SYSTEM 0x600c0000
 #define C3_SENSITIVE 0x600c1000
@@ -110,7 +120,9 @@ static inline void soc_init(void) {
   REG(C3_SYSTEM)[2] |= BIT(0) | BIT(2);
   REG(C3_SYSTEM)[22] = BIT(19) | (40U << 12) | BIT(10);
   // REG(C3_RTCCNTL)[47] = 0; // RTC_APB_FREQ_REG -> freq >> 12
+#ifndef MDK_HOST
   ((void (*)(int)) 0x40000588)(160);  // ets_update_cpu_frequency(160)
+#endif
 
 #if 0
   // Configure system clock timer, TRM 8.3.1, 8.9
@@ -120,6 +132,84 @@ static inline void soc_init(void) {
 #endif
 }
 
+// API boot and deep sleep. boot.c raises the clock first, then clears .bss,
+// and records a timestamp after each phase in boot_times[], in microseconds
+enum { BOOT_RESET, BOOT_CLOCK, BOOT_BSS, BOOT_INIT, BOOT_PHASES };
+extern uint32_t boot_times[BOOT_PHASES];  // Implemented in boot.c
+
+// Variables in RTC fast memory keep their values in deep sleep. boot.c
+// zeroes them on any other reset, so they cannot have initialisers
+#ifdef MDK_HOST
+#define RTC_ATTR
+#else
+#define RTC_ATTR __attribute__((section(".rtc")))
+#endif
+
+#define RTC_SLOW_KHZ 136  // RC_SLOW_CLK, approximate. TRM 6.2.3
+
+// True if this boot is a wakeup from deep sleep. Skip reinitialising state
+// kept in RTC_ATTR variables, and peripherals that keep their configuration
+static inline bool boot_warm(void) {
+  return (REG(C3_RTCCNTL)[14] & 0x3f) == 5;  // Reset cause: DEEPSLEEP_RESET
+}
+
+// Power down all but RTC, restart after `ms` milliseconds. TRM 9.4, 9.5
+static inline void deep_sleep_ms(unsigned long ms) {
+  uint64_t t;
+#ifdef MDK_HOST
+  host_deep_sleep(ms);  // No wakeup on host: the firmware exits
+#endif
+  REG(C3_RTCCNTL)[3] = BIT(31);  // RTC_CNTL_TIME_UPDATE: latch RTC timer
+  spin(10);
+  t = ((uint64_t) REG(C3_RTCCNTL)[5] << 32) | REG(C3_RTCCNTL)[4];
+  t += (uint64_t) ms * RTC_SLOW_KHZ;
+  REG(C3_RTCCNTL)[1] = (uint32_t) t;  // SLP_TIMER0, SLP_TIMER1: alarm
+  REG(C3_RTCCNTL)[2] = ((uint32_t) (t >> 32) & 0xffff) | BIT(16);
+  REG(C3_RTCCNTL)[15] = BIT(18);    // WAKEUP_STATE: wake up on timer
+  REG(C3_RTCCNTL)[34] &= ~BIT(20);  // PWC: keep RTC peripherals on
+  REG(C3_RTCCNTL)[35] |= BIT(31);   // DIG_PWC: power down digital core
+  REG(C3_RTCCNTL)[0] |= BIT(31);    // STATE0: sleep now
+  for (;;) spin(1);
+}
+
+// API interrupts. The interrupt matrix routes peripheral interrupt sources
+// to CPU interrupts 1..31, TRM 8. boot.c dispatches those to handlers
+struct irq_handler {
+  void (*fn)(void *arg);
+  void *arg;
+};
+extern struct irq_handler irq_handlers[32];  // Implemented in boot.c
+
+enum { IRQ_SOURCE_TWAI = 25 };  // Interrupt sources, TRM 8.4
+
+// Also sets MIE, so interrupts are on once the first handler is attached
+static inline void irq_attach(int source, int irq, void (*fn)(void *),
+                              void *arg) {
+  irq_handlers[irq].fn = fn, irq_handlers[irq].arg = arg;
+  REG(C3_INTERRUPT)[source] = (uint32_t) irq;  // Route source to CPU irq
+  REG(C3_INTERRUPT)[69 + irq] = 1;             // CPU_INT_PRI_n: priority 1
+  REG(C3_INTERRUPT)[65] |= BIT(irq);           // CPU_INT_ENABLE
+#ifndef MDK_HOST
+  asm volatile("csrsi mstatus, 8");  // Enable interrupts, MIE
+#endif
+}
+
+// Disable interrupts. Return previous state, for irq_restore()
+static inline uint32_t irq_save(void) {
+  uint32_t mstatus = 0;
+#ifndef MDK_HOST
+  asm volatile("csrrci %0, mstatus, 8" : "=r"(mstatus));
+#endif
+  return mstatus & 8;  // MIE bit
+}
+
+static inline void irq_restore(uint32_t state) {
+#ifndef MDK_HOST
+  if (state) asm volatile("csrsi mstatus, 8");
+#endif
+  (void) state;
+}
+
 // API GPIO
 
 static inline void gpio_output_enable(int pin, bool enable) {
@@ -194,6 +284,117 @@ static inline unsigned char spi_txn(struct spi *spi, unsigned char tx) {
   return rx;  // Return the received byte
 }
 
+// API flash, ROM SPI flash routines. Address, length and buffer must be
+// 4-byte aligned. Code runs from IRAM, so flash can be written at any time
+enum { FLASH_SECTOR_SIZE = 4096 };
+
+static inline bool flash_read(uint32_t addr, void *buf, size_t len) {
+  extern int esp_rom_spiflash_read(uint32_t, uint32_t *, int32_t);
+  return esp_rom_spiflash_read(addr, (uint32_t *) buf, (int32_t) len) == 0;
+}
+
+static inline void flash_unlock(void) {
+  extern int esp_rom_spiflash_unlock(void);
+  static bool unlocked;
+  if (!unlocked) (void) esp_rom_spiflash_unlock(), unlocked = true;
+}
+
+static inline bool flash_write(uint32_t addr, const void *buf, size_t len) {
+  extern int esp_rom_spiflash_write(uint32_t, const uint32_t *, int32_t);
+  flash_unlock();
+  return esp_rom_spiflash_write(addr, (const uint32_t *) buf,
+                                (int32_t) len) == 0;
+}
+
+// Erase sector that contains addr
+static inline bool flash_erase(uint32_t addr) {
+  extern int esp_rom_spiflash_erase_sector(uint32_t);
+  flash_unlock();
+  return esp_rom_spiflash_erase_sector(addr / FLASH_SECTOR_SIZE) == 0;
+}
+
+// API PWM, LEDC. TRM 31
+// 6 low speed channels, 4 timers. Timers are clocked from 80 MHz APB_CLK.
+// Duty is in timer resolution units: 0 .. (1 << bits)
+enum { PWM_CHANNELS = 6, PWM_TIMERS = 4, PWM_SIG_OUT = 45 };
+
+static inline bool pwm_timer_init(int timer, uint32_t freq, int bits) {
+  uint32_t div;
+  if (timer < 0 || timer >= PWM_TIMERS || bits < 1 || bits > 14) return false;
+  if (freq == 0 || (div = pwm_div(80000000U, freq, (unsigned) bits)) == 0)
+    return false;
+  REG(C3_SYSTEM)[4] |= BIT(11);     // SYSTEM_PERIP_CLK_EN0_REG, enable LEDC
+  REG(C3_SYSTEM)[6] &= ~BIT(11);    // SYSTEM_PERIP_RST_EN0_REG, unreset
+  REG(C3_LEDC)[52] = BIT(31) | 1U;  // LEDC_CONF_REG: clock on, APB_CLK
+  REG(C3_LEDC)[40 + timer * 2] = BIT(25) | (div << 4) | (uint32_t) bits;
+  return true;
+}
+
+static inline bool pwm_init(int ch, int timer, int pin) {
+  if (ch < 0 || ch >= PWM_CHANNELS || timer < 0 || timer >= PWM_TIMERS)
+    return false;
+  REG(C3_LEDC)[ch * 5 + 1] = 0;                          // HPOINT
+  REG(C3_LEDC)[ch * 5 + 2] = 0;                          // DUTY
+  REG(C3_LEDC)[ch * 5 + 3] = BIT(31);                    // DUTY_START
+  REG(C3_LEDC)[ch * 5] = BIT(4) | BIT(2) | (uint32_t) timer;  // Latch, on
+  REG(C3_GPIO)[GPIO_OUT_FUNC + pin] = BIT(9) | (uint32_t) (PWM_SIG_OUT + ch);
+  gpio_output_enable(pin, 1);
+  return true;
+}
+
+static inline void pwm_set(int ch, uint32_t duty) {
+  if (ch < 0 || ch >= PWM_CHANNELS) return;
+  REG(C3_LEDC)[ch * 5 + 2] = duty << 4;  // 4 fractional bits
+  REG(C3_LEDC)[ch * 5 + 3] = BIT(31) | BIT(30) | BIT(20) | BIT(10);
+  REG(C3_LEDC)[ch * 5] |= BIT(4);  // Latch at the next period
+}
+
+static inline uint32_t pwm_get(int ch) {
+  if (ch < 0 || ch >= PWM_CHANNELS) return 0;
+  return REG(C3_LEDC)[ch * 5 + 4] >> 4;
+}
+
+// Set duties of several channels, driven by the same timer, at once.
+// Wait for the timer overflow, so all writes land in the same period
+static inline void pwm_set_many(const int *chs, const uint32_t *duties,
+                                int n) {
+  uint32_t ovf;
+  for (int i = 0; i < n; i++) {
+    if (chs[i] < 0 || chs[i] >= PWM_CHANNELS) return;
+  }
+  if (n <= 0) return;
+  ovf = BIT(REG(C3_LEDC)[chs[0] * 5] & 3);  // Timer of the first channel
+  REG(C3_LEDC)[51] = ovf;                   // LEDC_INT_CLR_REG
+  while ((REG(C3_LEDC)[48] & ovf) == 0) spin(1);  // LEDC_INT_RAW_REG
+  for (int i = 0; i < n; i++) pwm_set(chs[i], duties[i]);
+}
+
+// Ramp duty from the current value to `duty` over `periods` PWM periods.
+// Runs in hardware, pwm_fade_done() tells when it is finished. Hardware
+// ramps take 1 .. 1023 periods per step, so the actual length can differ:
+// return it, in periods
+static inline uint32_t pwm_fade(int ch, uint32_t duty, uint32_t periods) {
+  uint32_t from, num, scale, cycles, len, inc;
+  if (ch < 0 || ch >= PWM_CHANNELS) return 0;
+  len = pwm_fade_plan(pwm_get(ch), duty, periods, &from, &num, &scale, &cycles);
+  if (len == 0) {
+    pwm_set(ch, duty);  // Nothing to ramp. Applied at the next period
+    return 1;
+  }
+  inc = duty > from ? 1 : 0;
+  REG(C3_LEDC)[51] = BIT(4 + ch);  // Clear "fade done"
+  REG(C3_LEDC)[ch * 5 + 2] = from << 4;
+  REG(C3_LEDC)[ch * 5 + 3] =
+      BIT(31) | (inc << 30) | (num << 20) | (cycles << 10) | scale;
+  REG(C3_LEDC)[ch * 5] |= BIT(4);
+  return len;
+}
+
+static inline bool pwm_fade_done(int ch) {
+  if (ch < 0 || ch >= PWM_CHANNELS) return false;
+  return REG(C3_LEDC)[48] & BIT(4 + ch) ? 1 : 0;
+}
+
 // API WS2812
 static inline void ws2812_show(int pin, const uint8_t *buf, size_t len) {
   unsigned long delays[2] = {2, 6};
@@ -208,6 +409,246 @@ static inline void ws2812_show(int pin, const uint8_t *buf, size_t len) {
   }
 }
 
+// API WS2812 parallel. ESP32C3 I2S has no LCD (parallel) mode, so strips are
+// bit-banged together: one GPIO_OUT_W1TS/W1TC write drives all strips.
+// Scratch buffer holds a precomputed GPIO mask per bit
+enum { WS2812_MAX_STRIPS = 16 };
+#define WS2812_SCRATCH_SIZE(len) ((len) * 8 * sizeof(uint32_t))
+
+static inline bool ws2812_parallel_init(const int *pins, int n) {
+  if (n < 1 || n > WS2812_MAX_STRIPS) return false;
+  for (int s = 0; s < n; s++) gpio_output(pins[s]), gpio_write(pins[s], 0);
+  return true;
+}
+
+// Send `len` bytes of each of `n` strips at once. `scratch` must be
+// WS2812_SCRATCH_SIZE(len) bytes, 4-byte aligned
+static inline void ws2812_parallel_show(const int *pins, int n,
+                                        const uint8_t *const *bufs,
+                                        size_t len, void *scratch) {
+  uint32_t *masks = (uint32_t *) scratch, all = 0;
+  uint16_t planes[8];
+  for (int s = 0; s < n; s++) all |= BIT(pins[s]);
+  for (size_t i = 0; i < len; i++) {
+    ws2812_transpose(planes, bufs, n, i);
+    for (int k = 0; k < 8; k++) {
+      uint32_t ones = 0;
+      for (int s = 0; s < n; s++) {
+        if (planes[k] & BIT(s)) ones |= BIT(pins[s]);
+      }
+      masks[i * 8 + (size_t) k] = all & ~ones;  // Pins that send "0"
+    }
+  }
+  for (size_t i = 0; i < len * 8; i++) {
+    REG(C3_GPIO)[2] = all;       // GPIO_OUT_W1TS_REG: all high
+    spin(2);                     // T0H
+    REG(C3_GPIO)[3] = masks[i];  // GPIO_OUT_W1TC_REG: "0" bits go low
+    spin(4);                     // T1H
+    REG(C3_GPIO)[3] = all;       // All low
+    spin(2);
+  }
+}
+
+// API TWAI (CAN), TRM 22. Interrupt driven: the handler moves received
+// frames into a ring buffer, and feeds the controller from a TX queue.
+// Both rings hold struct twai_frame records, see lib/ring.h
+struct twai_frame {
+  uint32_t id;      // 11-bit ID, or 29-bit if flags has TWAI_EXT
+  uint8_t flags;    // TWAI_EXT, TWAI_RTR
+  uint8_t len;      // Data length, 0 .. 8
+  uint8_t data[8];  // Payload
+  uint8_t pad[2];   // Keep the size a power of 2
+};
+
+enum { TWAI_EXT = 1, TWAI_RTR = 2 };
+enum { TWAI_IRQ = 1 };  // CPU interrupt used by the driver
+
+struct twai_stats {  // Updated by the interrupt handler
+  volatile uint32_t rx, tx;      // Frames received, sent
+  volatile uint32_t rx_dropped;  // RX ring was full
+  volatile uint32_t rx_overrun;  // Controller RX FIFO overflowed
+  volatile uint32_t arb_lost;    // Arbitration lost, hardware retries
+  volatile uint32_t bus_errors;  // Bus errors detected
+  volatile uint32_t bus_off;     // Bus-off events, recovered automatically
+};
+
+struct twai {
+  int tx, rx;               // Pins. Can be the same pin in self test mode
+  uint32_t bitrate;         // Bit rate, e.g. 1000000
+  bool self_test;           // Receive own frames, no ACK from others needed
+  struct ring rxq, txq;     // Set up by the caller with ring_init()
+  struct twai_stats stats;  // Counters
+  volatile bool tx_busy;    // Controller TX buffer holds a frame
+};
+
+// Bit timing for 80 MHz APB clock. A time quantum is 2 * (brp + 1) clocks,
+// a bit is 8 .. 20 quanta: 1 + tseg1 + tseg2, sampled at about 80%
+static inline bool twai_timing(uint32_t bitrate, uint32_t *btr0,
+                               uint32_t *btr1) {
+  for (uint32_t brp = 0; brp < 8192 && bitrate > 0; brp++) {
+    uint32_t div = 2 * (brp + 1), tq = 80000000U / div / bitrate, t1, t2;
+    if (tq > 20 || tq * div * bitrate != 80000000U) continue;
+    if (tq < 8) break;
+    t2 = (tq + 2) / 5, t1 = tq - 1 - t2;
+    *btr0 = ((t2 < 4 ? t2 : 4) - 1) << 14 | brp;  // SJW, BRP
+    *btr1 = (t2 - 1) << 4 | (t1 - 1);             // TSEG2, TSEG1
+    return true;
+  }
+  return false;
+}
+
+// Frame to and from the TX / RX buffer, registers DATA_0 .. DATA_12
+static inline void twai_frame_read(struct twai_frame *f) {
+  uint32_t info = REG(C3_TWAI)[16], i = 19;
+  f->flags = (uint8_t) ((info & BIT(7) ? TWAI_EXT : 0) |
+                        (info & BIT(6) ? TWAI_RTR : 0));
+  f->len = (uint8_t) ((info & 15) > 8 ? 8 : info & 15);
+  if (f->flags & TWAI_EXT) {
+    f->id = REG(C3_TWAI)[17] << 21 | REG(C3_TWAI)[18] << 13 |
+            REG(C3_TWAI)[19] << 5 | REG(C3_TWAI)[20] >> 3;
+    i = 21;
+  } else {
+    f->id = REG(C3_TWAI)[17] << 3 | REG(C3_TWAI)[18] >> 5;
+  }
+  for (uint32_t j = 0; j < f->len; j++) {
+    f->data[j] = f->flags & TWAI_RTR ? 0 : (uint8_t) REG(C3_TWAI)[i + j];
+  }
+}
+
+static inline void twai_frame_write(const struct twai_frame *f) {
+  uint32_t i = 19, len = f->len > 8 ? 8 : f->len;
+  REG(C3_TWAI)[16] = (f->flags & TWAI_EXT ? BIT(7) : 0) |
+                     (f->flags & TWAI_RTR ? BIT(6) : 0) | len;
+  if (f->flags & TWAI_EXT) {
+    uint32_t id = f->id << 3;
+    REG(C3_TWAI)[17] = id >> 24, REG(C3_TWAI)[18] = (id >> 16) & 255;
+    REG(C3_TWAI)[19] = (id >> 8) & 255, REG(C3_TWAI)[20] = id & 255;
+    i = 21;
+  } else {
+    REG(C3_TWAI)[17] = (f->id >> 3) & 255;
+    REG(C3_TWAI)[18] = (f->id & 7) << 5;
+  }
+  for (uint32_t j = 0; j < len && !(f->flags & TWAI_RTR); j++) {
+    REG(C3_TWAI)[i + j] = f->data[j];
+  }
+}
+
+// Load the next queued frame into the controller. Call with interrupts off
+static inline void twai_kick(struct twai *t) {
+  struct twai_frame f;
+  if (t->tx_busy || (REG(C3_TWAI)[2] & BIT(7))) return;  // Busy or bus-off
+  if (!ring_read(&t->txq, &f, sizeof(f))) return;
+  twai_frame_write(&f);
+  t->tx_busy = true;
+  REG(C3_TWAI)[1] = t->self_test ? BIT(4) : BIT(0);  // CMD: self RX, or TX
+}
+
+static inline void twai_isr(void *arg) {
+  struct twai *t = (struct twai *) arg;
+  uint32_t status, ints = REG(C3_TWAI)[3];  // INT_RAW, reading clears it
+  struct twai_frame f;
+  while (REG(C3_TWAI)[2] & BIT(0)) {  // STATUS: RX FIFO has frames
+    twai_frame_read(&f);
+    REG(C3_TWAI)[1] = BIT(2);  // CMD: release RX buffer
+    if (ring_write(&t->rxq, &f, sizeof(f))) {
+      t->stats.rx++;
+    } else {
+      t->stats.rx_dropped++;
+    }
+  }
+  if (ints & BIT(3)) t->stats.rx_overrun++, REG(C3_TWAI)[1] = BIT(3);
+  if (ints & BIT(6)) t->stats.arb_lost++, (void) REG(C3_TWAI)[11];
+  if (ints & BIT(7)) t->stats.bus_errors++, (void) REG(C3_TWAI)[12];
+  status = REG(C3_TWAI)[2];
+  if (ints & BIT(1)) {  // TX buffer released: sent, or aborted
+    if (status & BIT(3)) t->stats.tx++;
+    t->tx_busy = false;
+  }
+  if ((ints & BIT(2)) && (status & BIT(7))) {  // Error warning, bus-off
+    t->stats.bus_off++;
+    t->tx_busy = false;
+    REG(C3_TWAI)[0] &= ~BIT(0);  // Leave reset mode: start bus-off recovery
+  }
+  twai_kick(t);
+}
+
+// Acceptance filter, set in reset mode. Frames go to the RX FIFO if their
+// bits match `code` wherever `dont_care` bits are 0. See twai_filter_*()
+static inline void twai_filter_raw(struct twai *t, uint32_t code,
+                                   uint32_t dont_care, bool dual) {
+  uint32_t state = irq_save();
+  REG(C3_TWAI)[0] |= BIT(0);  // MODE: reset mode
+  for (int i = 0; i < 4; i++) {
+    REG(C3_TWAI)[16 + i] = (code >> (24 - 8 * i)) & 255;       // ACR0 .. 3
+    REG(C3_TWAI)[20 + i] = (dont_care >> (24 - 8 * i)) & 255;  // AMR0 .. 3
+  }
+  REG(C3_TWAI)[0] = (t->self_test ? BIT(2) : 0) | (dual ? 0 : BIT(3));
+  t->tx_busy = false;  // Reset mode aborts a pending transmission
+  twai_kick(t);
+  irq_restore(state);
+}
+
+// Single filter: accept IDs equal to `id` in the bits set in `mask`.
+// For all frames, use twai_filter(t, 0, 0, false)
+static inline void twai_filter(struct twai *t, uint32_t id, uint32_t mask,
+                               bool ext) {
+  if (ext) {
+    twai_filter_raw(t, id << 3, ~(mask << 3), false);
+  } else {
+    twai_filter_raw(t, id << 21, ~((mask & 0x7ff) << 21), false);
+  }
+}
+
+// Two filters on standard IDs: accept a frame if either one matches
+static inline void twai_filter_dual(struct twai *t, uint32_t id1,
+                                    uint32_t mask1, uint32_t id2,
+                                    uint32_t mask2) {
+  uint32_t code = (id1 & 0x7ff) << 21 | (id2 & 0x7ff) << 5;
+  uint32_t care = (mask1 & 0x7ff) << 21 | (mask2 & 0x7ff) << 5;
+  twai_filter_raw(t, code, ~care, true);
+}
+
+// Start the controller, accepting all frames
+static inline bool twai_init(struct twai *t) {
+  uint32_t btr0, btr1;
+  if (!twai_timing(t->bitrate, &btr0, &btr1)) return false;
+  REG(C3_SYSTEM)[4] |= BIT(19);   // SYSTEM_PERIP_CLK_EN0_REG, enable TWAI
+  REG(C3_SYSTEM)[6] &= ~BIT(19);  // SYSTEM_PERIP_RST_EN0_REG, unreset
+  REG(C3_TWAI)[0] = BIT(0);       // MODE: reset mode
+  REG(C3_TWAI)[6] = btr0, REG(C3_TWAI)[7] = btr1;  // BUS_TIMING_0, 1
+  REG(C3_TWAI)[4] = 0xef;  // INT_ENA: all but data overrun wakeup
+  gpio_input(t->rx);
+  REG(C3_IO_MUX)[1 + t->rx] |= BIT(9);                        // Input on
+  REG(C3_GPIO)[GPIO_IN_FUNC + 74] = BIT(6) | (uint32_t) t->rx;  // twai_rx
+  REG(C3_GPIO)[GPIO_OUT_FUNC + t->tx] = BIT(9) | 74;            // twai_tx
+  gpio_output_enable(t->tx, 1);
+  memset(&t->stats, 0, sizeof(t->stats));
+  t->tx_busy = false;
+  irq_attach(IRQ_SOURCE_TWAI, TWAI_IRQ, twai_isr, t);
+  twai_filter(t, 0, 0, false);  // Also leaves reset mode
+  return true;
+}
+
+// Queue a frame for sending. Return false if the TX queue is full
+static inline bool twai_send(struct twai *t, const struct twai_frame *f) {
+  uint32_t state;
+  if (!ring_write(&t->txq, f, sizeof(*f))) return false;
+  state = irq_save();
+  twai_kick(t);
+  irq_restore(state);
+  return true;
+}
+
+// Take a received frame from the RX ring. Return false if there is none
+static inline bool twai_recv(struct twai *t, struct twai_frame *f) {
+  return ring_read(&t->rxq, f, sizeof(*f));
+}
+
+// Error counters kept by the controller, TEC and REC
+static inline void twai_errors(uint32_t *tec, uint32_t *rec) {
+  *tec = REG(C3_TWAI)[15] & 255, *rec = REG(C3_TWAI)[14] & 255;
+}
+
 // Default settings for board peripherals
 
 #ifndef LED1
@@ -217,3 +658,7 @@ static inline void ws2812_show(int pin, const uint8_t *buf, size_t len) {
 #ifndef BTN1
 #define BTN1 9  // Default user button pin
 #endif
+
+#ifndef MDK_FAST_MEM
+#define MDK_FAST_MEM 0  // 1: use lib/mem.h instead of ROM memcpy() & co
+#endif
@@ -0,0 +1,160 @@
+#include <mdk.h>
+
+// Time MDK primitives, print one JSON line per result. Compare runs with
+// tools/benchcmp. On the host build, time is virtual
+#if defined(MDK_HOST)
+#define BENCH_ARCH "host"
+#elif defined(__XTENSA__)
+#define BENCH_ARCH "esp32"
+#else
+#define BENCH_ARCH "esp32c3"
+#endif
+
+#define N 10000  // Iterations for per-call costs
+
+static uint8_t s_src[4096], s_dst[4096];
+static volatile uint64_t s_sink;  // Keeps results alive
+
+static void result(const char *name, unsigned long value, const char *unit) {
+  printf("{\"arch\":\"%s\",\"name\":\"%s\",\"value\":%lu,\"unit\":\"%s\"}\n",
+         BENCH_ARCH, name, value, unit);
+}
+
+static void result_signed(const char *name, long value, const char *unit) {
+  printf("{\"arch\":\"%s\",\"name\":\"%s\",\"value\":%ld,\"unit\":\"%s\"}\n",
+         BENCH_ARCH, name, value, unit);
+}
+
+static unsigned long ns(uint64_t us, unsigned long n) {
+  return (unsigned long) (us * 1000 / n);
+}
+
+static unsigned long kbps(uint64_t bytes, uint64_t us) {
+  return us == 0 ? 0 : (unsigned long) (bytes * 1000 / us);
+}
+
+static void bench_gpio(void) {
+  uint64_t t = uptime_us();
+  for (unsigned long i = 0; i < N; i++) gpio_write(LED1, i & 1);
+  result("gpio_write", ns(uptime_us() - t, N), "ns");
+  t = uptime_us();
+  for (unsigned long i = 0; i < N; i++) gpio_toggle(LED1);
+  result("gpio_toggle", ns(uptime_us() - t, N), "ns");
+}
+
+static void bench_spi(void) {
+  struct spi spi = {.miso = 4, .mosi = 5, .clk = 0, .cs = -1, .spin = 0};
+  uint64_t t;
+  spi_init(&spi);
+  t = uptime_us();
+  for (size_t i = 0; i < 1024; i++) s_sink += spi_txn(&spi, s_src[i]);
+  result("spi_txn", kbps(1024, uptime_us() - t), "KB/s");
+}
+
+static void bench_time(void) {
+  uint64_t t = uptime_us();
+  for (unsigned long i = 0; i < N; i++) s_sink += uptime_us();
+  result("uptime_us", ns(uptime_us() - t, N), "ns");
+  t = uptime_us();
+  for (unsigned long i = 0; i < N; i++) s_sink += systick();
+  result("systick", ns(uptime_us() - t, N), "ns");
+}
+
+// Error is the average overshoot, jitter is max - min, both in us
+static void bench_delay(void) {
+  unsigned long delays[] = {10, 100, 1000};
+  char name[40];
+  for (size_t i = 0; i < sizeof(delays) / sizeof(delays[0]); i++) {
+    unsigned long sum = 0, min = ~0UL, max = 0;
+    for (int j = 0; j < 20; j++) {
+      uint64_t t = uptime_us();
+      delay_us(delays[i]);
+      unsigned long took = (unsigned long) (uptime_us() - t);
+      sum += took, min = took < min ? took : min, max = took > max ? took : max;
+    }
+    snprintf(name, sizeof(name), "delay_us_%lu_error", delays[i]);
+    result_signed(name, (long) (sum / 20) - (long) delays[i], "us");
+    snprintf(name, sizeof(name), "delay_us_%lu_jitter", delays[i]);
+    result(name, max - min, "us");
+  }
+}
+
+// Called through volatile pointers, so GCC cannot replace them with inline
+// builtins: the library, ROM or MDK_FAST_MEM versions are what gets timed
+static void *(*volatile s_memcpy)(void *, const void *, size_t) = memcpy;
+static void *(*volatile s_memset)(void *, int, size_t) = memset;
+static void *(*volatile s_memmove)(void *, const void *, size_t) = memmove;
+static int (*volatile s_memcmp)(const void *, const void *, size_t) = memcmp;
+
+// Checksum the destination after a run, so the stores are observable
+static void sink(const uint8_t *buf, size_t len) {
+  for (size_t i = 0; i < len; i++) s_sink += buf[i];
+}
+
+// Offsets: both buffers aligned, destination misaligned, source misaligned.
+// Build with EXTRA_CFLAGS=-DMDK_FAST_MEM=1 and compare against ROM versions
+static void bench_mem(void) {
+  size_t sizes[] = {16, 256, 4000}, total = 256 * 1024;
+  size_t offsets[][2] = {{0, 0}, {1, 0}, {0, 1}};
+  const char *suffix[] = {"", "_dst1", "_src1"};
+  char name[40];
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    size_t size = sizes[i];
+    for (size_t j = 0; j < sizeof(offsets) / sizeof(offsets[0]); j++) {
+      uint8_t *dst = s_dst + offsets[j][0], *src = s_src + offsets[j][1];
+      uint64_t t = uptime_us();
+      for (size_t n = 0; n < total; n += size) s_memcpy(dst, src, size);
+      snprintf(name, sizeof(name), "memcpy_%u%s", (unsigned) size, suffix[j]);
+      result(name, kbps(total, uptime_us() - t), "KB/s");
+      sink(dst, size);
+    }
+    uint64_t t = uptime_us();
+    for (size_t n = 0; n < total; n += size) s_memset(s_dst, (int) n, size);
+    snprintf(name, sizeof(name), "memset_%u", (unsigned) size);
+    result(name, kbps(total, uptime_us() - t), "KB/s");
+    sink(s_dst, size);
+    t = uptime_us();
+    for (size_t n = 0; n < total; n += size) s_memmove(s_dst + 4, s_dst, size);
+    snprintf(name, sizeof(name), "memmove_%u", (unsigned) size);
+    result(name, kbps(total, uptime_us() - t), "KB/s");
+    sink(s_dst, size + 4);
+    s_memcpy(s_dst, s_src, size);
+    t = uptime_us();
+    for (size_t n = 0; n < total; n += size) {
+      s_sink += (uint64_t) s_memcmp(s_dst, s_src, size);
+    }
+    snprintf(name, sizeof(name), "memcmp_%u", (unsigned) size);
+    result(name, kbps(total, uptime_us() - t), "KB/s");
+  }
+}
+
+static void bench_printf(void) {
+  uint64_t t = uptime_us();
+  for (int i = 0; i < 10; i++) printf("printf %d %s\n", i, "0123456789");
+  result("printf", ns(uptime_us() - t, 10), "ns");
+}
+
+static void bench_ws2812(void) {
+  uint8_t buf[60 * 3];  // 60 LEDs
+  uint64_t t;
+  memset(buf, 0, sizeof(buf));
+  gpio_output(LED1);
+  t = uptime_us();
+  ws2812_show(LED1, buf, sizeof(buf));
+  result("ws2812_show_60", (unsigned long) (uptime_us() - t), "us");
+}
+
+int main(void) {
+  wdt_disable();
+  gpio_output(LED1);
+  for (size_t i = 0; i < sizeof(s_src); i++) s_src[i] = (uint8_t) i;
+  bench_gpio();
+  bench_spi();
+  bench_time();
+  bench_delay();
+  bench_mem();
+  bench_printf();
+  bench_ws2812();
+  result("done", 0, "");
+  return 0;
+}
@@ -0,0 +1,29 @@
+#include <mdk.h>
+
+// Duty-cycled sensor skeleton: wake up, take a sample, go back to deep sleep.
+// State kept in RTC memory survives the sleep, and is set up on cold boots only
+struct state {
+  uint32_t wakeups;  // Deep sleep wakeups since the cold boot
+  uint32_t sum;      // Sum of samples, for the average
+};
+static struct state s_state RTC_ATTR;
+
+int main(void) {
+  uint32_t sample = (uint32_t) uptime_us() & 0xff;  // Stand-in for a sensor
+  wdt_disable();
+  if (boot_warm()) {
+    s_state.wakeups++;
+  } else {
+    printf("Cold boot, RTC state cleared\n");
+  }
+  s_state.sum += sample;
+  printf("Wakeup #%lu, average %lu. Boot: clock %lu, bss %lu, init %lu us\n",
+         (unsigned long) s_state.wakeups,
+         (unsigned long) (s_state.sum / (s_state.wakeups + 1)),
+         (unsigned long) (boot_times[BOOT_CLOCK] - boot_times[BOOT_RESET]),
+         (unsigned long) (boot_times[BOOT_BSS] - boot_times[BOOT_CLOCK]),
+         (unsigned long) (boot_times[BOOT_INIT] - boot_times[BOOT_BSS]));
+  delay_ms(10);  // Let UART drain
+  deep_sleep_ms(1000);
+  return 0;
+}
@@ -0,0 +1,39 @@
+#include <mdk.h>
+
+// APP CPU produces samples into a lock-free ring, PRO CPU prints them.
+// esp32 only
+static uint32_t s_stack[1024];  // APP CPU stack
+static uint8_t s_storage[256];  // Ring storage
+static struct ring s_ring;
+
+static void app_main(void *arg) {
+  struct ring *r = (struct ring *) arg;
+  for (uint32_t i = 0;; i++) {
+    uint64_t sample[2] = {i, uptime_us()};
+    while (!ring_write(r, sample, sizeof(sample))) spin(1);
+    cpu_notify(0);  // Wake up PRO CPU
+    delay_ms(500);
+  }
+}
+
+static void on_notify(void *arg) {
+  (void) arg;
+  cpu_notify_clear(0);
+}
+
+int main(void) {
+  ring_init(&s_ring, s_storage, sizeof(s_storage));
+  cpu_notify_attach(0, on_notify, NULL);
+  cpu_start(app_main, &s_ring, s_stack, sizeof(s_stack));
+
+  for (;;) {
+    uint64_t sample[2];
+    while (ring_read(&s_ring, sample, sizeof(sample))) {
+      printf("core %d: sample %lu from APP CPU at %lu us\n", cpu_id(),
+             (unsigned long) sample[0], (unsigned long) sample[1]);
+    }
+    cpu_wait();
+  }
+
+  return 0;
+}
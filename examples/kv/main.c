@@ -0,0 +1,33 @@
+#include <mdk.h>
+
+// Count reboots in a key/value store that lives in the last 64k of the
+// first 2MB of flash
+static struct kv_slot s_index[64];
+static struct kv s_kv = {
+    .read = flash_read,
+    .write = flash_write,
+    .erase = flash_erase,
+    .start = 0x1f0000,
+    .sector_size = FLASH_SECTOR_SIZE,
+    .sectors = 16,
+    .index = s_index,
+    .index_size = sizeof(s_index) / sizeof(s_index[0]),
+};
+
+int main(void) {
+  uint32_t boots = 0;
+  wdt_disable();
+  if (!kv_open(&s_kv)) printf("kv_open failed\n");
+  kv_get(&s_kv, "boots", &boots, sizeof(boots));
+  boots++;
+  kv_set(&s_kv, "boots", &boots, sizeof(boots));
+  printf("Boot #%lu, %lu keys\n", (unsigned long) boots,
+         (unsigned long) s_kv.count);
+
+  for (;;) {
+    kv_gc(&s_kv, 1);  // Use idle time for garbage collection
+    delay_ms(100);
+  }
+
+  return 0;
+}
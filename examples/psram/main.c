@@ -0,0 +1,40 @@
+#include <mdk.h>
+
+// Compare memory bandwidth of internal DRAM and external PSRAM.
+// esp32 only, needs a WROVER module
+#define SMALL_SIZE 16384          // Fits into the 32k cache
+#define LARGE_SIZE (1024 * 1024)  // Does not
+static uint32_t s_dram[SMALL_SIZE / 4];
+static uint32_t s_psram[SMALL_SIZE / 4] PSRAM_ATTR;
+
+static unsigned long kbps(size_t size, size_t rounds, uint64_t us) {
+  return (unsigned long) ((uint64_t) size * rounds * 1000 / us);
+}
+
+static void bench(const char *name, volatile uint32_t *p, size_t size) {
+  size_t n = size / 4, rounds = LARGE_SIZE / size * 4;
+  uint32_t sum = 0;
+  uint64_t t0 = uptime_us(), t1, t2;
+  for (size_t r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < n; i++) p[i] = (uint32_t) i;
+  }
+  t1 = uptime_us();
+  for (size_t r = 0; r < rounds; r++) {
+    for (size_t i = 0; i < n; i++) sum += p[i];
+  }
+  t2 = uptime_us();
+  printf("%-12s %8u bytes: write %5lu KB/s, read %5lu KB/s (%lx)\n", name,
+         (unsigned) size, kbps(size, rounds, t1 - t0),
+         kbps(size, rounds, t2 - t1), (unsigned long) sum);
+}
+
+int main(void) {
+  void *large = psram_malloc(LARGE_SIZE);
+  printf("PSRAM size: %lu bytes\n", (unsigned long) psram_size());
+  bench("DRAM", s_dram, sizeof(s_dram));
+  if (psram_size() > 0) bench("PSRAM", s_psram, sizeof(s_psram));
+  if (large != NULL) bench("PSRAM heap", large, LARGE_SIZE);
+  psram_free(large);
+  for (;;) delay_ms(1000);
+  return 0;
+}
@@ -0,0 +1,18 @@
+#include <mdk.h>
+
+// Breathe an LED using the LEDC hardware fade. The CPU only starts ramps
+enum { TIMER = 0, CHANNEL = 0, BITS = 10, PERIODS = 1000 };
+
+int main(void) {
+  wdt_disable();
+  pwm_timer_init(TIMER, 1000, BITS);  // 1 kHz, 10 bit resolution
+  pwm_init(CHANNEL, TIMER, LED1);
+
+  for (uint32_t duty = BIT(BITS);; duty = duty ? 0 : BIT(BITS)) {
+    pwm_fade(CHANNEL, duty, PERIODS);              // Ramp over 1 second
+    while (!pwm_fade_done(CHANNEL)) delay_ms(10);  // CPU is free meanwhile
+    printf("PWM duty: %lu\n", (unsigned long) pwm_get(CHANNEL));
+  }
+
+  return 0;
+}
@@ -0,0 +1,28 @@
+#include <mdk.h>
+
+// Drive 8 strips of 60 LEDs at once, each strip showing a shifted colour
+enum { STRIPS = 8, LEDS = 60 };
+
+static int s_pins[STRIPS] = {0, 1, 2, 3, 4, 5, 6, 7};
+static uint8_t s_leds[STRIPS][LEDS * 3];  // GRB bytes per strip
+static uint32_t s_scratch[WS2812_SCRATCH_SIZE(LEDS * 3) / 4 + 1];
+
+int main(void) {
+  const uint8_t *bufs[STRIPS];
+  wdt_disable();
+  for (int s = 0; s < STRIPS; s++) bufs[s] = s_leds[s];
+  ws2812_parallel_init(s_pins, STRIPS);
+  printf("%d x %d LEDs: up to %lu fps\n", STRIPS, LEDS, ws2812_fps(LEDS));
+
+  for (unsigned frame = 0;; frame++) {
+    for (int s = 0; s < STRIPS; s++) {
+      for (int i = 0; i < LEDS * 3; i++) {
+        s_leds[s][i] = (uint8_t) ((frame + (unsigned) (s * 32 + i)) & 63);
+      }
+    }
+    ws2812_parallel_show(s_pins, STRIPS, bufs, sizeof(s_leds[0]), s_scratch);
+    delay_ms(20);
+  }
+
+  return 0;
+}
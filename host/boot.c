@@ -0,0 +1,215 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// Host simulation of the esp32c3 register file. Environment variables:
+//   MDK_RUN_US=N   - exit after N microseconds of virtual time
+//   MDK_REALTIME=1 - SYSTIMER follows the host clock, e.g. for benchmarks
+//   MDK_TRACE=1    - print GPIO output changes to stderr
+//   MDK_PTY=1      - send UART to a pty instead of stdout
+//   MDK_FLASH=FILE - SPI flash image, created on first use. Default: flash.bin
+//
+// By default, virtual time advances 1 us each time the firmware reads
+// SYSTIMER, so runs are deterministic and do not depend on host speed
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+
+#include "mdk.h"
+
+#define REG_START 0x60000000  // Simulated register file
+#define REG_END 0x600d4000
+#define FLASH_SIZE (4 * 1024 * 1024)
+
+static uint32_t s_regs[(REG_END - REG_START) / 4];
+static struct host_model *s_models, *s_last;  // Models, last accessed one
+static uint64_t s_us, s_run_us, s_start;      // Time, time limit, host start
+static uint32_t s_inputs = ~0U;               // Input pin levels
+static uint32_t s_out;                        // Last traced GPIO_OUT
+static bool s_trace, s_realtime;
+static int s_uart_fd = -1;  // pty master, or -1 for stdout
+static int s_flash_fd = -1;
+
+uint32_t boot_times[BOOT_PHASES];  // Firmware starts at main(), all zero
+struct irq_handler irq_handlers[32];  // No interrupts, tests call them
+
+static void fail(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  exit(EXIT_FAILURE);
+}
+
+static void sync_model(struct host_model *m) {
+  if (m != NULL) m->sync(&s_regs[(m->base - REG_START) / 4]);
+}
+
+volatile uint32_t *host_reg(uintptr_t addr) {
+  struct host_model *m = s_models;
+  if (addr < REG_START || addr >= REG_END || addr % 4)
+    fail("Invalid register address %#lx\n", (unsigned long) addr);
+  while (m != NULL && (addr < m->base || addr >= m->base + m->size))
+    m = m->next;
+  if (s_last != m) sync_model(s_last);  // Writes to the previous block
+  sync_model(m);                        // Writes since, and fresh reads
+  s_last = m;
+  return &s_regs[(addr - REG_START) / 4];
+}
+
+void host_model_add(struct host_model *m) {
+  m->next = s_models, s_models = m;
+}
+
+uint64_t host_time_us(void) {
+  return s_us;
+}
+
+void host_gpio_set(int pin, bool level) {
+  s_inputs &= ~BIT(pin);
+  s_inputs |= (level ? 1U : 0U) << pin;
+}
+
+// Deep sleep would restart from reset with RTC memory kept. That is not
+// simulated, the firmware exits as if it never woke up
+void host_deep_sleep(unsigned long ms) {
+  (void) ms;
+  exit(EXIT_SUCCESS);
+}
+
+static uint64_t host_clock_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000 + (uint64_t) ts.tv_nsec / 1000;
+}
+
+// SYSTIMER, TRM 10.5. Writing UPDATE latches the counter at 16 MHz
+static void systimer_sync(volatile uint32_t *regs) {
+  if ((regs[1] & BIT(30)) == 0) return;
+  regs[1] &= ~BIT(30);
+  if (s_realtime) s_us = host_clock_us() - s_start;
+  regs[16] = (uint32_t) ((s_us * 16) >> 32), regs[17] = (uint32_t) (s_us * 16);
+  if (s_run_us > 0 && s_us >= s_run_us) fflush(stdout), exit(EXIT_SUCCESS);
+  if (!s_realtime) s_us++;
+}
+
+// GPIO, TRM 5.14. OUT_W1TS/W1TC update OUT; IN reads outputs or s_inputs
+static void gpio_sync(volatile uint32_t *regs) {
+  if (regs[2] != 0) regs[1] |= regs[2], regs[2] = 0;      // GPIO_OUT_W1TS
+  if (regs[3] != 0) regs[1] &= ~regs[3], regs[3] = 0;     // GPIO_OUT_W1TC
+  if (regs[9] != 0) regs[8] |= regs[9], regs[9] = 0;      // GPIO_ENABLE_W1TS
+  if (regs[10] != 0) regs[8] &= ~regs[10], regs[10] = 0;  // GPIO_ENABLE_W1TC
+  regs[15] = (regs[1] & regs[8]) | (s_inputs & ~regs[8]);  // GPIO_IN
+  if (s_trace && regs[1] != s_out) {
+    for (int i = 0; i < 32; i++) {
+      if ((regs[1] ^ s_out) & BIT(i)) {
+        fprintf(stderr, "%8lu us: GPIO%d %d\n", (unsigned long) s_us, i,
+                regs[1] & BIT(i) ? 1 : 0);
+      }
+    }
+  }
+  s_out = regs[1];
+}
+
+static struct host_model s_systimer = {C3_SYSTIMER, 0x1000, systimer_sync,
+                                       NULL};
+static struct host_model s_gpio = {C3_GPIO, 0x1000, gpio_sync, NULL};
+
+// ROM UART functions, on stdout/stdin or on a pty
+int uart_tx_one_char(int c) {
+  unsigned char ch = (unsigned char) c;
+  if (s_uart_fd < 0) return putchar(c) == EOF;
+  return write(s_uart_fd, &ch, 1) != 1;
+}
+
+int uart_rx_one_char(uint8_t *c) {
+  struct pollfd pfd = {s_uart_fd < 0 ? 0 : s_uart_fd, POLLIN, 0};
+  if (poll(&pfd, 1, 0) != 1) return 1;
+  return read(pfd.fd, c, 1) != 1;  // 0 on success
+}
+
+// ROM SPI flash functions, on a file. Writes can only clear bits
+static void flash_open(void);
+
+static bool flash_io(uint32_t addr, void *buf, size_t len, bool wr) {
+  if (addr + len > FLASH_SIZE || addr % 4 || len % 4) return false;
+  if (s_flash_fd < 0) flash_open();
+  if (wr) return pwrite(s_flash_fd, buf, len, addr) == (ssize_t) len;
+  return pread(s_flash_fd, buf, len, addr) == (ssize_t) len;
+}
+
+int esp_rom_spiflash_read(uint32_t addr, uint32_t *buf, int32_t len) {
+  return flash_io(addr, buf, (size_t) len, false) ? 0 : 1;
+}
+
+int esp_rom_spiflash_write(uint32_t addr, const uint32_t *buf, int32_t len) {
+  uint32_t tmp[64];
+  for (int32_t i = 0; i < len; i += (int32_t) sizeof(tmp)) {
+    size_t n = (size_t) (len - i) < sizeof(tmp) ? (size_t) (len - i)
+                                                : sizeof(tmp);
+    uint32_t a = addr + (uint32_t) i;
+    if (!flash_io(a, tmp, n, false)) return 1;
+    for (size_t j = 0; j < n / 4; j++) tmp[j] &= buf[(size_t) i / 4 + j];
+    if (!flash_io(a, tmp, n, true)) return 1;
+  }
+  return 0;
+}
+
+int esp_rom_spiflash_erase_sector(uint32_t sector) {
+  uint32_t tmp[FLASH_SECTOR_SIZE / 4];
+  memset(tmp, 0xff, sizeof(tmp));
+  return flash_io(sector * FLASH_SECTOR_SIZE, tmp, sizeof(tmp), true) ? 0 : 1;
+}
+
+int esp_rom_spiflash_unlock(void) {
+  return 0;
+}
+
+static void flash_open(void) {
+  const char *path = getenv("MDK_FLASH") ? getenv("MDK_FLASH") : "flash.bin";
+  struct stat st;
+  s_flash_fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (s_flash_fd < 0) fail("open %s: %s\n", path, strerror(errno));
+  if (fstat(s_flash_fd, &st) == 0 && st.st_size < FLASH_SIZE) {
+    for (uint32_t a = 0; a < FLASH_SIZE; a += FLASH_SECTOR_SIZE) {
+      esp_rom_spiflash_erase_sector(a / FLASH_SECTOR_SIZE);
+    }
+  }
+}
+
+static void uart_open_pty(void) {
+  int slave;
+  char name[100];
+  if (openpty(&s_uart_fd, &slave, name, NULL, NULL) != 0)
+    fail("openpty: %s\n", strerror(errno));
+  fcntl(s_uart_fd, F_SETFL, fcntl(s_uart_fd, F_GETFL) | O_NONBLOCK);
+  dup2(s_uart_fd, 1);  // printf() goes to the pty, too
+  fprintf(stderr, "UART on %s\n", name);
+}
+
+static void at_exit(void) {
+  sync_model(s_last);  // Flush pending writes
+  fflush(stdout);
+}
+
+__attribute__((constructor)) static void host_init(void) {
+  const char *s;
+  host_model_add(&s_systimer);
+  host_model_add(&s_gpio);
+  if ((s = getenv("MDK_RUN_US")) != NULL) s_run_us = strtoull(s, NULL, 0);
+  if ((s = getenv("MDK_TRACE")) != NULL) s_trace = atoi(s) > 0;
+  if ((s = getenv("MDK_REALTIME")) != NULL) s_realtime = atoi(s) > 0;
+  s_start = host_clock_us();
+  if ((s = getenv("MDK_PTY")) != NULL && atoi(s) > 0) uart_open_pty();
+  setvbuf(stdout, NULL, _IOLBF, 0);
+  atexit(at_exit);
+}
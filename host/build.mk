@@ -0,0 +1,39 @@
+PROG        ?= firmware
+ARCH        ?= host
+MDK         ?= $(realpath $(dir $(lastword $(MAKEFILE_LIST)))/..)
+CFLAGS      ?= -W -Wall -Wextra -Werror -Wundef -Wshadow -pedantic \
+               -Wdouble-promotion -fno-common -Wconversion \
+               -O2 -g -I. -I$(MDK)/$(ARCH) $(EXTRA_CFLAGS)
+LINKFLAGS   ?= -lutil $(EXTRA_LINKFLAGS)
+CCACHE      ?=  # Set to ccache to use it
+SRCS        ?= $(MDK)/$(ARCH)/boot.c $(SOURCES)
+OBJDIR      ?= $(PROG)-$(ARCH)
+OBJS        ?= $(patsubst %.c,$(OBJDIR)%.o,$(abspath $(SRCS)))
+
+build: $(PROG)
+
+# Objects mirror absolute source paths under OBJDIR. -MMD tracks headers,
+# the flags file tracks CFLAGS: changing e.g. -DMDK_FAST_MEM rebuilds all
+$(OBJDIR)/%.o: /%.c $(OBJDIR)/cflags
+	@mkdir -p $(dir $@)
+	$(CCACHE) $(CC) $(CFLAGS) -MMD -MP -c $< -o $@
+
+$(PROG): $(OBJS)
+	$(CC) $(CFLAGS) $(OBJS) $(LINKFLAGS) -o $@
+
+# Run natively, e.g. make run MDK_RUN_US=3000000 MDK_TRACE=1
+run: $(PROG)
+	MDK_RUN_US=$(MDK_RUN_US) MDK_TRACE=$(MDK_TRACE) \
+    MDK_REALTIME=$(MDK_REALTIME) ./$(PROG)
+
+clean:
+	@rm -rf $(PROG) $(OBJDIR) $(PROG).dSYM flash.bin
+
+# Rewritten only when CFLAGS differ from the previous build
+$(OBJDIR)/cflags: FORCE
+	@mkdir -p $(dir $@)
+	@echo '$(CFLAGS)' | cmp -s - $@ || echo '$(CFLAGS)' > $@
+
+FORCE:
+
+-include $(OBJS:.o=.d)
@@ -0,0 +1,34 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// Host build: firmware runs natively as a Linux or Mac process. The API is
+// that of esp32c3, but registers live in simulated memory. Peripheral models
+// keep them consistent: SYSTIMER runs on a virtual clock, GPIO outputs can be
+// traced, UART goes to stdout or to a pty, SPI flash is a file. See boot.c
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MDK_HOST 1
+#define REG(x) host_reg((uintptr_t) (x))
+
+// A peripheral model. sync() is called before the firmware accesses the
+// register block, and after it moves on to another block. It should act on
+// registers written since the last call, and refresh registers it reads
+struct host_model {
+  uintptr_t base;                         // Register block address
+  size_t size;                            // Register block size
+  void (*sync)(volatile uint32_t *regs);  // Model logic
+  struct host_model *next;                // Next model in the list
+};
+
+volatile uint32_t *host_reg(uintptr_t addr);
+void host_model_add(struct host_model *m);
+uint64_t host_time_us(void);              // Virtual time
+void host_gpio_set(int pin, bool level);  // Drive an input pin
+void host_deep_sleep(unsigned long ms);   // Power down for good: exit
+
+#include "../esp32c3/mdk.h"
@@ -0,0 +1,141 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// Bosch BME280 and BMP280 sensor driver. The bus is abstracted by read and
+// write callbacks, so it works over SPI or I2C. Calibration is read once by
+// bme280_init(), and each sample is a single burst read of 0xF7 .. 0xFE.
+// Compensation is the integer code from the BME280 datasheet, 4.2.3 and 8.2.
+// Architecture independent, builds on a workstation too
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BME280_ID 0x60  // Chip ID register values
+#define BMP280_ID 0x58  // BMP280 has no humidity sensor
+
+struct bme280_calib {
+  uint16_t t1, p1;
+  int16_t t2, t3, p2, p3, p4, p5, p6, p7, p8, p9;
+  int16_t h2, h4, h5;
+  uint8_t h1, h3;
+  int8_t h6;
+};
+
+struct bme280 {
+  // Read `len` registers starting from `reg`. Over SPI, set bit 7 of `reg`
+  bool (*read)(void *ctx, uint8_t reg, uint8_t *buf, size_t len);
+  // Write one register. Over SPI, clear bit 7 of `reg`
+  bool (*write)(void *ctx, uint8_t reg, uint8_t val);
+  // Sleep at least `ms` milliseconds, e.g. delay_ms. Used after reset
+  void (*delay_ms)(unsigned long ms);
+  void *ctx;                  // Bus handle, e.g. struct spi * or I2C address
+  uint8_t id;                 // Set by bme280_init(): BME280_ID or BMP280_ID
+  struct bme280_calib calib;  // Set by bme280_init()
+};
+
+struct bme280_data {
+  int32_t temp;       // Temperature, 0.01 degrees C: 5123 is 51.23 C
+  uint32_t pressure;  // Pressure, 1/256 Pa: 24674867 is 96386.2 Pa
+  uint32_t humidity;  // Relative humidity, 1/1024 %: 47445 is 46.333 %RH
+};
+
+// Calibration from registers 0x88 .. 0xA1 and, on BME280, 0xE1 .. 0xE7
+static inline void bme280_parse_calib(struct bme280_calib *c,
+                                      const uint8_t tp[26],
+                                      const uint8_t h[7]) {
+#define BME280_U16(p) ((uint16_t) ((p)[0] | (p)[1] << 8))
+  c->t1 = BME280_U16(&tp[0]), c->t2 = (int16_t) BME280_U16(&tp[2]);
+  c->t3 = (int16_t) BME280_U16(&tp[4]), c->p1 = BME280_U16(&tp[6]);
+  c->p2 = (int16_t) BME280_U16(&tp[8]), c->p3 = (int16_t) BME280_U16(&tp[10]);
+  c->p4 = (int16_t) BME280_U16(&tp[12]), c->p5 = (int16_t) BME280_U16(&tp[14]);
+  c->p6 = (int16_t) BME280_U16(&tp[16]), c->p7 = (int16_t) BME280_U16(&tp[18]);
+  c->p8 = (int16_t) BME280_U16(&tp[20]), c->p9 = (int16_t) BME280_U16(&tp[22]);
+  c->h1 = tp[25];
+  if (h == NULL) return;
+  c->h2 = (int16_t) BME280_U16(&h[0]), c->h3 = h[2];
+  c->h4 = (int16_t) ((int8_t) h[3] * 16 | (h[4] & 15));  // 12-bit, signed
+  c->h5 = (int16_t) ((int8_t) h[5] * 16 | h[4] >> 4);
+  c->h6 = (int8_t) h[6];
+#undef BME280_U16
+}
+
+// Temperature in 0.01 C. Also returns t_fine, an input for the others
+static inline int32_t bme280_temp(const struct bme280_calib *c, int32_t adc,
+                                  int32_t *t_fine) {
+  int32_t t1 = c->t1, v1, v2;
+  v1 = (((adc >> 3) - (t1 << 1)) * c->t2) >> 11;
+  v2 = (((((adc >> 4) - t1) * ((adc >> 4) - t1)) >> 12) * c->t3) >> 14;
+  *t_fine = v1 + v2;
+  return (*t_fine * 5 + 128) >> 8;
+}
+
+// Pressure in 1/256 Pa. The 64-bit variant: the 32-bit one is off by up to
+// 6 Pa. Division uses __divdi3 from ROM
+static inline uint32_t bme280_pressure(const struct bme280_calib *c,
+                                       int32_t adc, int32_t t_fine) {
+  int64_t v1 = (int64_t) t_fine - 128000, v2, p;
+  v2 = v1 * v1 * c->p6;
+  v2 = v2 + v1 * c->p5 * 131072;
+  v2 = v2 + (int64_t) c->p4 * 34359738368;
+  v1 = ((v1 * v1 * c->p3) >> 8) + (v1 * c->p2 * 4096);
+  v1 = ((((int64_t) 1) << 47) + v1) * c->p1 >> 33;
+  if (v1 == 0) return 0;  // Avoid division by zero
+  p = 1048576 - adc;
+  p = ((p * 2147483648) - v2) * 3125 / v1;
+  v1 = (c->p9 * (p >> 13) * (p >> 13)) >> 25;
+  v2 = (c->p8 * p) >> 19;
+  return (uint32_t) (((p + v1 + v2) >> 8) + ((int64_t) c->p7 * 16));
+}
+
+// Relative humidity in 1/1024 %
+static inline uint32_t bme280_humidity(const struct bme280_calib *c,
+                                       int32_t adc, int32_t t_fine) {
+  int32_t v = t_fine - 76800;
+  v = (((adc * 16384) - (c->h4 * 1048576) - (c->h5 * v) + 16384) >> 15) *
+      (((((((v * c->h6) >> 10) * (((v * c->h3) >> 11) + 32768)) >> 10) +
+         2097152) * c->h2 + 8192) >> 14);
+  v = v - (((((v >> 15) * (v >> 15)) >> 7) * c->h1) >> 4);
+  v = v < 0 ? 0 : v > 419430400 ? 419430400 : v;
+  return (uint32_t) (v >> 12);
+}
+
+// Check chip ID, reset, read calibration, start measuring continuously:
+// 1x oversampling, no filter, 250 ms standby
+static inline bool bme280_init(struct bme280 *dev) {
+  uint8_t tp[26], h[7], status = 1;
+  if (!dev->read(dev->ctx, 0xd0, &dev->id, 1)) return false;
+  if (dev->id != BME280_ID && dev->id != BMP280_ID) return false;
+  if (!dev->write(dev->ctx, 0xe0, 0xb6)) return false;  // Soft reset
+  dev->delay_ms(2);  // Start-up time, datasheet 1.1. NVM copy starts late
+  for (int i = 0; i < 10 && (status & 1); i++) {  // Wait NVM copy, im_update
+    if (i > 0) dev->delay_ms(1);
+    if (!dev->read(dev->ctx, 0xf3, &status, 1)) return false;
+  }
+  if (status & 1) return false;
+  if (!dev->read(dev->ctx, 0x88, tp, sizeof(tp))) return false;
+  if (dev->id == BME280_ID && !dev->read(dev->ctx, 0xe1, h, sizeof(h)))
+    return false;
+  bme280_parse_calib(&dev->calib, tp, dev->id == BME280_ID ? h : NULL);
+  if (dev->id == BME280_ID && !dev->write(dev->ctx, 0xf2, 1))  // ctrl_hum
+    return false;
+  return dev->write(dev->ctx, 0xf5, 3 << 5) &&  // config: 250 ms standby
+         dev->write(dev->ctx, 0xf4, 1 << 5 | 1 << 2 | 3);  // ctrl_meas: normal
+}
+
+// Read a sample: one burst of pressure, temperature and humidity registers
+static inline bool bme280_read(struct bme280 *dev, struct bme280_data *d) {
+  uint8_t b[8];
+  int32_t t_fine, adc_p, adc_t, adc_h;
+  size_t len = dev->id == BME280_ID ? 8 : 6;
+  if (!dev->read(dev->ctx, 0xf7, b, len)) return false;
+  adc_p = (int32_t) ((uint32_t) b[0] << 12 | (uint32_t) b[1] << 4 | b[2] >> 4);
+  adc_t = (int32_t) ((uint32_t) b[3] << 12 | (uint32_t) b[4] << 4 | b[5] >> 4);
+  adc_h = b[6] << 8 | b[7];
+  d->temp = bme280_temp(&dev->calib, adc_t, &t_fine);
+  d->pressure = bme280_pressure(&dev->calib, adc_p, t_fine);
+  d->humidity = len < 8 ? 0 : bme280_humidity(&dev->calib, adc_h, t_fine);
+  return true;
+}
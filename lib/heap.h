@@ -0,0 +1,75 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// First-fit allocator over a fixed memory region, e.g. external PSRAM.
+// Free blocks are kept in an address-ordered list, and merged with their
+// neighbours on free. Each block starts with a header that holds its size
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct heap_block {
+  size_t size;              // Block size, including this header
+  struct heap_block *next;  // Next free block, valid only when free
+};
+
+struct heap {
+  struct heap_block *free;  // Free list, sorted by address
+  size_t size;              // Total size of the region
+  size_t used;              // Statistics: bytes allocated, with headers
+};
+
+#define HEAP_ALIGN sizeof(struct heap_block)
+
+static inline size_t heap_align(size_t n) {
+  return (n + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+}
+
+static inline void heap_init(struct heap *h, void *buf, size_t size) {
+  uintptr_t start = heap_align((uintptr_t) buf);
+  h->free = NULL, h->size = h->used = 0;
+  if (size < start - (uintptr_t) buf + HEAP_ALIGN) return;
+  h->size = (size - (start - (uintptr_t) buf)) & ~(HEAP_ALIGN - 1);
+  h->free = (struct heap_block *) start;
+  h->free->size = h->size, h->free->next = NULL;
+}
+
+static inline void *heap_alloc(struct heap *h, size_t n) {
+  size_t size = heap_align(n + HEAP_ALIGN);
+  if (n == 0 || size < n) return NULL;
+  for (struct heap_block **p = &h->free; *p != NULL; p = &(*p)->next) {
+    struct heap_block *b = *p;
+    if (b->size < size) continue;
+    if (b->size - size >= 2 * HEAP_ALIGN) {  // Split, keep the tail free
+      struct heap_block *rest = (struct heap_block *) ((char *) b + size);
+      rest->size = b->size - size, rest->next = b->next;
+      b->size = size, *p = rest;
+    } else {
+      *p = b->next;
+    }
+    h->used += b->size;
+    return b + 1;
+  }
+  return NULL;
+}
+
+static inline void heap_free(struct heap *h, void *ptr) {
+  struct heap_block *b, *prev = NULL, *next;
+  if (ptr == NULL) return;
+  b = (struct heap_block *) ptr - 1;
+  h->used -= b->size;
+  for (next = h->free; next != NULL && next < b; next = next->next) prev = next;
+  b->next = next;
+  if (next != NULL && (char *) b + b->size == (char *) next) {
+    b->size += next->size, b->next = next->next;  // Merge with the next
+  }
+  if (prev == NULL) {
+    h->free = b;
+  } else if ((char *) prev + prev->size == (char *) b) {
+    prev->size += b->size, prev->next = b->next;  // Merge with the previous
+  } else {
+    prev->next = b;
+  }
+}
@@ -0,0 +1,416 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// Log-structured key/value store on NOR flash. Records are appended to the
+// newest (head) sector. The oldest (tail) sector is garbage collected
+// incrementally: its live records are copied to the head, then it is erased,
+// so sectors are used round-robin and wear evenly. Sectors are kept in
+// reserve, so GC can always make progress, even after a power loss during GC.
+//
+// A record is written as header, body, then CRC: it is committed when the
+// CRC matches. A power loss leaves either the old or the new value, and a
+// torn record is skipped using the length in its header. A RAM hash index
+// maps keys to record addresses, so lookups do not scan flash.
+//
+// Flash is accessed via callbacks, always with 4-byte aligned addresses,
+// lengths and buffers, so a file-backed emulator can stand in on a host.
+//
+// Sector: MAGIC SEQ RECORD RECORD ... 0xff 0xff ...
+// Record: HDR CRC KEY PAD VALUE PAD. HDR is TAG(8) VLEN(16) KLEN(8)
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define KV_MAGIC 0x3176646d    // "mdv1", sector header
+#define KV_TAG 0x4bU           // Record header tag
+#define KV_DELETED 0xffffU     // VLEN of a deleted key
+#define KV_ERASED 0xffffffffU  // Erased flash word
+#define KV_RESERVE 2           // Free sectors used only by GC
+
+struct kv_slot {
+  uint32_t hash;  // Key hash
+  uint32_t addr;  // Record offset from kv->start, 0 if slot is empty
+};
+
+struct kv {
+  // Set by the caller before kv_open()
+  bool (*read)(uint32_t addr, void *buf, size_t len);
+  bool (*write)(uint32_t addr, const void *buf, size_t len);
+  bool (*erase)(uint32_t addr);  // Erase sector at addr
+  uint32_t start;                // Flash region start, sector aligned
+  uint32_t sector_size;          // Sector size, e.g. 4096
+  uint32_t sectors;              // Number of sectors, at least 4
+  struct kv_slot *index;         // Index storage
+  uint32_t index_size;           // Number of slots, a power of 2
+  // Internal state
+  uint32_t count;        // Number of keys
+  uint32_t seq;          // Sequence number of the head sector
+  uint32_t head, pos;    // Head sector, and append offset in it
+  uint32_t tail, gcpos;  // Tail sector, and GC offset in it
+  uint32_t used;         // Sectors in use, from tail to head
+  uint32_t written;      // Statistics: bytes written to flash
+  uint32_t erased;       // Statistics: sectors erased
+};
+
+static inline uint32_t kv_crc32(uint32_t crc, const void *buf, size_t len) {
+  static const uint32_t t[16] = {
+      0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4,
+      0x4db26158, 0x5005713c, 0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+      0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c};
+  const uint8_t *p = (const uint8_t *) buf;
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    crc = (crc >> 4) ^ t[crc & 15];
+    crc = (crc >> 4) ^ t[crc & 15];
+  }
+  return ~crc;
+}
+
+static inline uint32_t kv_hash(const char *key, size_t len) {
+  uint32_t h = 2166136261U;  // FNV-1a
+  while (len--) h = (h ^ (uint8_t) *key++) * 16777619U;
+  return h;
+}
+
+static inline uint32_t kv_align(uint32_t n) {
+  return (n + 3) & ~3U;
+}
+
+static inline uint32_t kv_size(uint32_t hdr) {
+  uint32_t klen = hdr & 255, vlen = (hdr >> 8) & 0xffff;
+  return 8 + kv_align(klen) + (vlen == KV_DELETED ? 0 : kv_align(vlen));
+}
+
+static inline uint32_t kv_sector(struct kv *kv, uint32_t no) {
+  return no * kv->sector_size;
+}
+
+// Read `len` bytes at aligned offset `ofs`, into any buffer.
+// Update *crc if it is not NULL
+static inline bool kv_read(struct kv *kv, uint32_t ofs, void *buf, size_t len,
+                           uint32_t *crc) {
+  uint32_t tmp[16];
+  for (size_t n = 0; n < len;) {
+    size_t chunk = len - n > sizeof(tmp) ? sizeof(tmp) : len - n;
+    uint32_t addr = kv->start + ofs + (uint32_t) n;
+    if (!kv->read(addr, tmp, kv_align((uint32_t) chunk))) return false;
+    if (buf != NULL) memcpy((uint8_t *) buf + n, tmp, chunk);
+    if (crc != NULL) *crc = kv_crc32(*crc, tmp, chunk);
+    n += chunk;
+  }
+  return true;
+}
+
+// Buffered writer: accumulates bytes in an aligned buffer
+struct kv_wr {
+  struct kv *kv;
+  uint32_t ofs;      // Where to flush next
+  uint32_t buf[16];  // Aligned buffer
+  size_t len;        // Bytes in buf
+  bool ok;           // False if any write failed
+};
+
+static inline void kv_wr_flush(struct kv_wr *w) {
+  if (w->len == 0) return;
+  if (!w->kv->write(w->kv->start + w->ofs, w->buf, w->len)) w->ok = false;
+  w->kv->written += (uint32_t) w->len;
+  w->ofs += (uint32_t) w->len, w->len = 0;
+}
+
+static inline void kv_wr_put(struct kv_wr *w, const void *buf, size_t len) {
+  const uint8_t *p = (const uint8_t *) buf;
+  while (len > 0) {
+    size_t n = sizeof(w->buf) - w->len;
+    if (n > len) n = len;
+    memcpy((uint8_t *) w->buf + w->len, p, n);
+    w->len += n, p += n, len -= n;
+    if (w->len == sizeof(w->buf)) kv_wr_flush(w);
+  }
+}
+
+static inline void kv_wr_pad(struct kv_wr *w) {
+  static const uint8_t ff[3] = {0xff, 0xff, 0xff};  // Leave padding erased
+  kv_wr_put(w, ff, kv_align((uint32_t) w->len) - w->len);
+}
+
+// Read record header at `ofs` in a sector that ends at `end`. Return record
+// size, or 0 if there is no record. Set *valid if the CRC matches
+static inline uint32_t kv_rec(struct kv *kv, uint32_t ofs, uint32_t end,
+                              uint32_t *hdr, bool *valid) {
+  uint32_t h[2], size, klen, vlen, crc;
+  *valid = false;
+  if (ofs + 8 > end || !kv->read(kv->start + ofs, h, sizeof(h))) return 0;
+  if ((h[0] >> 24) != KV_TAG || (h[0] & 255) == 0) return 0;
+  size = kv_size(h[0]), klen = h[0] & 255, vlen = (h[0] >> 8) & 0xffff;
+  if (ofs + size > end) return 0;
+  crc = kv_crc32(0, &h[0], sizeof(h[0]));
+  if (!kv_read(kv, ofs + 8, NULL, klen, &crc)) return 0;
+  if (vlen != KV_DELETED &&
+      !kv_read(kv, ofs + 8 + kv_align(klen), NULL, vlen, &crc))
+    return 0;
+  *hdr = h[0], *valid = crc == h[1];
+  return size;
+}
+
+// Return the index slot of a key: either where it is, or an empty one
+static inline struct kv_slot *kv_slot(struct kv *kv, const char *key,
+                                      size_t klen, uint32_t hash) {
+  uint32_t mask = kv->index_size - 1, i = hash & mask;
+  char buf[255];
+  for (;; i = (i + 1) & mask) {
+    struct kv_slot *s = &kv->index[i];
+    uint32_t hdr;
+    if (s->addr == 0) return s;
+    if (s->hash != hash) continue;
+    if (!kv->read(kv->start + s->addr, &hdr, sizeof(hdr))) continue;
+    if ((hdr & 255) != klen) continue;
+    if (kv_read(kv, s->addr + 8, buf, klen, NULL) && !memcmp(buf, key, klen))
+      return s;
+  }
+}
+
+// Remove a slot, shifting following entries back. No tombstones needed
+static inline void kv_unindex(struct kv *kv, struct kv_slot *s) {
+  uint32_t mask = kv->index_size - 1, i = (uint32_t) (s - kv->index), j = i;
+  for (;;) {
+    j = (j + 1) & mask;
+    if (kv->index[j].addr == 0) break;
+    if (((j - kv->index[j].hash) & mask) >= ((j - i) & mask)) {
+      kv->index[i] = kv->index[j], i = j;  // Home is not in (i, j], move
+    }
+  }
+  kv->index[i].addr = 0;
+  kv->count--;
+}
+
+// True if the index has room for one more key. kv_set() keeps the load
+// below 75%, mount may fill it up to one empty slot, which lookups need
+static inline bool kv_fits(struct kv *kv, bool mount) {
+  if (mount) return kv->count + 1 < kv->index_size;
+  return (kv->count + 1) * 4 <= kv->index_size * 3;
+}
+
+// Point the index to a record at `ofs`, or remove the key if it is deleted.
+// A new key that does not fit is not indexed. Return false on read error
+static inline bool kv_apply(struct kv *kv, uint32_t ofs, uint32_t hdr) {
+  char key[255];
+  uint32_t klen = hdr & 255, hash;
+  struct kv_slot *s;
+  if (!kv_read(kv, ofs + 8, key, klen, NULL)) return false;
+  hash = kv_hash(key, klen);
+  s = kv_slot(kv, key, klen, hash);
+  if (((hdr >> 8) & 0xffff) == KV_DELETED) {
+    if (s->addr != 0) kv_unindex(kv, s);
+  } else if (s->addr != 0) {
+    s->addr = ofs;
+  } else if (kv_fits(kv, true)) {
+    s->hash = hash, s->addr = ofs, kv->count++;
+  }
+  return true;
+}
+
+static inline bool kv_erased(struct kv *kv, uint32_t ofs, uint32_t end) {
+  uint32_t tmp[16];
+  for (; ofs < end; ofs += sizeof(tmp)) {
+    uint32_t n = end - ofs > sizeof(tmp) ? sizeof(tmp) : end - ofs;
+    if (!kv->read(kv->start + ofs, tmp, n)) return false;
+    for (uint32_t i = 0; i < n / 4; i++) {
+      if (tmp[i] != KV_ERASED) return false;
+    }
+  }
+  return true;
+}
+
+static inline bool kv_erase(struct kv *kv, uint32_t no) {
+  kv->erased++;
+  return kv->erase(kv->start + kv_sector(kv, no));
+}
+
+static inline bool kv_put32(struct kv *kv, uint32_t ofs, uint32_t val) {
+  kv->written += sizeof(val);
+  return kv->write(kv->start + ofs, &val, sizeof(val));
+}
+
+// Start a new head sector. Free sectors are always erased.
+// Sequence number goes first, magic last, so a torn header is not valid
+static inline bool kv_next(struct kv *kv) {
+  uint32_t no = (kv->head + 1) % kv->sectors, ofs = kv_sector(kv, no);
+  if (kv->used >= kv->sectors) return false;
+  if (!kv_put32(kv, ofs + 4, kv->seq + 1) || !kv_put32(kv, ofs, KV_MAGIC))
+    return false;
+  kv->head = no, kv->pos = 8, kv->seq++, kv->used++;
+  return true;
+}
+
+// Copy a record verbatim to the head. Use the reserve sector only if forced
+static inline bool kv_copy(struct kv *kv, uint32_t from, uint32_t size,
+                           uint32_t *to, bool force) {
+  struct kv_wr w = {kv, 0, {0}, 0, true};
+  uint32_t h[2], tmp[16], dst;
+  if (kv->pos + size > kv->sector_size) {
+    if (!force && kv->sectors - kv->used <= KV_RESERVE) return false;
+    if (!kv_next(kv)) return false;
+  }
+  if (!kv->read(kv->start + from, h, sizeof(h))) return false;
+  dst = kv_sector(kv, kv->head) + kv->pos;
+  if (!kv_put32(kv, dst, h[0])) return false;
+  kv->pos += size, w.ofs = dst + 8;
+  for (uint32_t n = 8; n < size; n += sizeof(tmp)) {
+    uint32_t chunk = size - n > sizeof(tmp) ? sizeof(tmp) : size - n;
+    if (!kv->read(kv->start + from + n, tmp, chunk)) return false;
+    kv_wr_put(&w, tmp, chunk);
+  }
+  kv_wr_flush(&w);
+  if (!w.ok || !kv_put32(kv, dst + 4, h[1])) return false;
+  *to = dst;
+  return true;
+}
+
+// Do one GC step: move one live record out of the tail sector, or erase the
+// tail when it is done. Return false if no progress can be made
+static inline bool kv_gc_step(struct kv *kv, bool force) {
+  uint32_t ofs = kv_sector(kv, kv->tail) + kv->gcpos, hdr = 0, size;
+  uint32_t end = kv_sector(kv, kv->tail) + kv->sector_size;
+  bool valid;
+  if (kv->used < 2) return false;  // Never collect the head
+  if ((size = kv_rec(kv, ofs, end, &hdr, &valid)) == 0) {
+    if (!kv_erase(kv, kv->tail)) return false;
+    kv->tail = (kv->tail + 1) % kv->sectors, kv->gcpos = 8, kv->used--;
+    return true;
+  }
+  if (valid && ((hdr >> 8) & 0xffff) != KV_DELETED) {
+    char key[255];
+    uint32_t klen = hdr & 255;
+    struct kv_slot *s;
+    if (!kv_read(kv, ofs + 8, key, klen, NULL)) return false;
+    s = kv_slot(kv, key, klen, kv_hash(key, klen));
+    if (s->addr == ofs && !kv_copy(kv, ofs, size, &s->addr, force))
+      return false;
+  }
+  kv->gcpos += size;
+  return true;
+}
+
+// Do up to `steps` GC steps, e.g. when idle
+static inline void kv_gc(struct kv *kv, int steps) {
+  while (steps-- > 0 && kv_gc_step(kv, false)) (void) 0;
+}
+
+// Make room for `size` bytes at the head, collecting garbage if needed
+static inline bool kv_room(struct kv *kv, uint32_t size) {
+  for (uint32_t i = 0; i < kv->sectors; i++) {
+    uint32_t tail = kv->tail;
+    if (kv->pos + size <= kv->sector_size) return true;
+    if (kv->sectors - kv->used > KV_RESERVE) return kv_next(kv);
+    while (kv->tail == tail && kv_gc_step(kv, true)) (void) 0;  // Whole tail
+    if (kv->tail == tail) return false;
+  }
+  return false;
+}
+
+// Append a record: header, body, then CRC, which commits it. A new key is
+// refused before anything is written if the index has no room for it
+static inline bool kv_append(struct kv *kv, const char *key, size_t klen,
+                             const void *val, uint32_t vlen) {
+  uint32_t hdr = (KV_TAG << 24) | (vlen << 8) | (uint32_t) klen, crc, ofs;
+  uint32_t size = kv_size(hdr);
+  struct kv_wr w = {kv, 0, {0}, 0, true};
+  if (klen == 0 || klen > 255 || size > kv->sector_size - 8) return false;
+  if (vlen != KV_DELETED && !kv_fits(kv, false) &&
+      kv_slot(kv, key, klen, kv_hash(key, klen))->addr == 0)
+    return false;
+  if (kv->sectors - kv->used <= KV_RESERVE + 1) kv_gc_step(kv, false);
+  if (!kv_room(kv, size)) return false;
+  ofs = kv_sector(kv, kv->head) + kv->pos;
+  if (!kv_put32(kv, ofs, hdr)) {
+    kv->pos = kv->sector_size;  // Torn header, do not append after it
+    return false;
+  }
+  kv->pos += size, w.ofs = ofs + 8;
+  crc = kv_crc32(kv_crc32(0, &hdr, sizeof(hdr)), key, klen);
+  kv_wr_put(&w, key, klen);
+  kv_wr_pad(&w);
+  if (vlen != KV_DELETED) {
+    crc = kv_crc32(crc, val, vlen);
+    kv_wr_put(&w, val, vlen);
+    kv_wr_pad(&w);
+  }
+  kv_wr_flush(&w);
+  if (!w.ok || !kv_put32(kv, ofs + 4, crc)) return false;
+  return kv_apply(kv, ofs, hdr);
+}
+
+// Mount the store: find the tail and head sectors, and replay the log to
+// build the index. Format the region if there is no store in it
+static inline bool kv_open(struct kv *kv) {
+  uint32_t hdr[2], found = 0, min = 0;
+  if (kv->sectors < KV_RESERVE + 2 || kv->sector_size < 64 ||
+      kv->sector_size % 4 || kv->index_size == 0 ||
+      (kv->index_size & (kv->index_size - 1)))
+    return false;
+  memset(kv->index, 0, kv->index_size * sizeof(kv->index[0]));
+  kv->count = kv->seq = kv->used = kv->written = kv->erased = 0;
+  kv->head = kv->sectors - 1, kv->tail = 0, kv->pos = kv->sector_size;
+  for (uint32_t i = 0; i < kv->sectors; i++) {
+    if (!kv->read(kv->start + kv_sector(kv, i), hdr, sizeof(hdr))) return false;
+    if (hdr[0] != KV_MAGIC) continue;
+    if (found == 0 || hdr[1] < min) min = hdr[1], kv->tail = i;
+    if (found == 0 || hdr[1] > kv->seq) kv->seq = hdr[1], kv->head = i;
+    found++;
+  }
+  if (found > 0) {
+    kv->used = (kv->head + kv->sectors - kv->tail) % kv->sectors + 1;
+  }
+  for (uint32_t i = kv->used; i < kv->sectors; i++) {  // Free sectors
+    uint32_t no = (kv->tail + i) % kv->sectors, ofs = kv_sector(kv, no);
+    if (!kv_erased(kv, ofs, ofs + kv->sector_size) && !kv_erase(kv, no))
+      return false;
+  }
+  for (uint32_t i = 0; i < kv->used; i++) {  // Replay, oldest first
+    uint32_t no = (kv->tail + i) % kv->sectors, ofs = kv_sector(kv, no) + 8;
+    uint32_t end = kv_sector(kv, no) + kv->sector_size, size, h = 0;
+    bool valid;
+    while ((size = kv_rec(kv, ofs, end, &h, &valid)) > 0) {
+      if (valid && !kv_apply(kv, ofs, h)) return false;
+      ofs += size;
+    }
+    if (no == kv->head) {  // Append only if the rest of the head is erased
+      bool clean = kv_erased(kv, ofs, end);
+      kv->pos = clean ? ofs - kv_sector(kv, no) : kv->sector_size;
+    }
+  }
+  kv->gcpos = 8;
+  return kv->used > 0 || kv_next(kv);
+}
+
+// Copy up to `len` bytes of the value to `buf`. Return value length, or -1
+static inline int kv_get(struct kv *kv, const char *key, void *buf,
+                         size_t len) {
+  size_t klen = strlen(key);
+  struct kv_slot *s = kv_slot(kv, key, klen, kv_hash(key, klen));
+  uint32_t hdr, vlen;
+  if (s->addr == 0 || !kv->read(kv->start + s->addr, &hdr, sizeof(hdr)))
+    return -1;
+  vlen = (hdr >> 8) & 0xffff;
+  if (len > vlen) len = vlen;
+  if (!kv_read(kv, s->addr + 8 + kv_align((uint32_t) klen), buf, len, NULL))
+    return -1;
+  return (int) vlen;
+}
+
+static inline bool kv_set(struct kv *kv, const char *key, const void *val,
+                          size_t len) {
+  if (len >= KV_DELETED) return false;
+  return kv_append(kv, key, strlen(key), val, (uint32_t) len);
+}
+
+static inline bool kv_del(struct kv *kv, const char *key) {
+  size_t klen = strlen(key);
+  if (kv_slot(kv, key, klen, kv_hash(key, klen))->addr == 0) return true;
+  return kv_append(kv, key, klen, NULL, KV_DELETED);
+}
@@ -0,0 +1,117 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// Word-wide memcpy(), memset(), memmove() and memcmp(). ROM versions copy a
+// byte at a time: these move 32-bit words, 4 per loop iteration, when
+// buffers allow. Sources misaligned against the destination are read as
+// aligned words and shifted into place. No unaligned accesses are made, and
+// no bytes outside of the buffers are touched. Little endian only.
+// Architecture independent, builds on a workstation too. Firmware uses them
+// instead of ROM functions when built with -DMDK_FAST_MEM=1, see boot.c
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "lib/mem.h supports little endian only"
+#endif
+
+// Word access that may alias any type. Stop GCC from turning loops below
+// into calls to memcpy() and memset(), which would recurse
+typedef uint32_t __attribute__((may_alias)) mem_word_t;
+#define MEM_ATTR __attribute__((optimize("no-tree-loop-distribute-patterns")))
+
+// Short misaligned copies are faster a byte at a time
+#define MEM_SHIFT_MIN 32
+
+MEM_ATTR static inline void *mem_copy(void *dst, const void *src, size_t n) {
+  uint8_t *d = (uint8_t *) dst;
+  const uint8_t *s = (const uint8_t *) src;
+  if ((((uintptr_t) d ^ (uintptr_t) s) & 3) == 0 && n >= 8) {
+    mem_word_t *dw;
+    const mem_word_t *sw;
+    while ((uintptr_t) d & 3) *d++ = *s++, n--;  // Align both
+    dw = (mem_word_t *) d, sw = (const mem_word_t *) s;
+    for (; n >= 16; n -= 16, dw += 4, sw += 4) {
+      dw[0] = sw[0], dw[1] = sw[1], dw[2] = sw[2], dw[3] = sw[3];
+    }
+    for (; n >= 4; n -= 4) *dw++ = *sw++;
+    d = (uint8_t *) dw, s = (const uint8_t *) sw;
+  } else if (n >= MEM_SHIFT_MIN) {
+    mem_word_t *dw;
+    const mem_word_t *sw;
+    unsigned k, lo, hi;
+    uint32_t carry = 0, w;
+    while ((uintptr_t) d & 3) *d++ = *s++, n--;  // Align destination
+    // Source is k bytes past an aligned word. Carry holds 4 - k source
+    // bytes that precede the next aligned word
+    k = (unsigned) ((uintptr_t) s & 3), lo = 8 * k, hi = 32 - lo;
+    for (unsigned i = 0; i < 4 - k; i++) carry |= (uint32_t) s[i] << (8 * i);
+    dw = (mem_word_t *) d, sw = (const mem_word_t *) (s - k + 4);
+    for (; n >= 8; n -= 4) {
+      w = *sw++;
+      *dw++ = carry | (w << hi);
+      carry = w >> lo;
+    }
+    d = (uint8_t *) dw, s = (const uint8_t *) sw - (4 - k);
+  }
+  while (n--) *d++ = *s++;
+  return dst;
+}
+
+MEM_ATTR static inline void *mem_fill(void *dst, int c, size_t n) {
+  uint8_t *d = (uint8_t *) dst, b = (uint8_t) c;
+  if (n >= 8) {
+    uint32_t v = b * 0x01010101U;
+    mem_word_t *dw;
+    while ((uintptr_t) d & 3) *d++ = b, n--;
+    dw = (mem_word_t *) d;
+    for (; n >= 16; n -= 16, dw += 4) dw[0] = dw[1] = dw[2] = dw[3] = v;
+    for (; n >= 4; n -= 4) *dw++ = v;
+    d = (uint8_t *) dw;
+  }
+  while (n--) *d++ = b;
+  return dst;
+}
+
+// Copy forward when the destination is below the source: mem_copy() never
+// writes ahead of what it has read. Otherwise copy backward
+MEM_ATTR static inline void *mem_move(void *dst, const void *src, size_t n) {
+  uint8_t *d = (uint8_t *) dst + n;
+  const uint8_t *s = (const uint8_t *) src + n;
+  if ((uintptr_t) dst - (uintptr_t) src >= n) return mem_copy(dst, src, n);
+  if ((((uintptr_t) d ^ (uintptr_t) s) & 3) == 0 && n >= 8) {
+    mem_word_t *dw;
+    const mem_word_t *sw;
+    while ((uintptr_t) d & 3) *--d = *--s, n--;
+    dw = (mem_word_t *) d, sw = (const mem_word_t *) s;
+    for (; n >= 16; n -= 16) {
+      dw -= 4, sw -= 4;
+      dw[3] = sw[3], dw[2] = sw[2], dw[1] = sw[1], dw[0] = sw[0];
+    }
+    for (; n >= 4; n -= 4) *--dw = *--sw;
+    d = (uint8_t *) dw, s = (const uint8_t *) sw;
+  }
+  while (n--) *--d = *--s;
+  return dst;
+}
+
+MEM_ATTR static inline int mem_compare(const void *a, const void *b,
+                                       size_t n) {
+  const uint8_t *x = (const uint8_t *) a, *y = (const uint8_t *) b;
+  if ((((uintptr_t) x ^ (uintptr_t) y) & 3) == 0 && n >= 8) {
+    const mem_word_t *xw, *yw;
+    for (; (uintptr_t) x & 3; x++, y++, n--) {
+      if (*x != *y) return *x - *y;
+    }
+    xw = (const mem_word_t *) x, yw = (const mem_word_t *) y;
+    for (; n >= 4 && *xw == *yw; n -= 4) xw++, yw++;  // Bytes find the diff
+    x = (const uint8_t *) xw, y = (const uint8_t *) yw;
+  }
+  for (; n > 0; x++, y++, n--) {
+    if (*x != *y) return *x - *y;
+  }
+  return 0;
+}
@@ -0,0 +1,44 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// LEDC timer divider and fade arithmetic, shared by esp32 and esp32c3.
+// Architecture independent, builds on a workstation too
+
+#pragma once
+
+#include <stdint.h>
+
+// Return 10.8 fixed point divider for clk / (freq << bits), or 0 if invalid
+static inline uint32_t pwm_div(uint32_t clk, uint32_t freq, unsigned bits) {
+  uint32_t q = clk / freq, r = clk % freq, div;
+  if ((q >> bits) >= 1024) return 0;  // Divider is 18 bits wide
+  if (bits >= 8) {
+    div = q >> (bits - 8);
+  } else {
+    div = ((q << 8) + (freq > 0xffffffU ? 0 : (r << 8) / freq)) >> bits;
+  }
+  return div < 256 ? 0 : div;  // Divider must be >= 1.0
+}
+
+// Plan a hardware fade from duty `from` to `to` over `periods` PWM periods:
+// `num` steps of `scale`, one every `cycles` periods, all 1 .. 1023. Steps
+// are made as small as possible, and their count reduced to fit. The ramp
+// ends exactly on `to` and starts at `*start`, less than a step away from
+// `from`. That is one step, or two if `scale` had to be clamped, for
+// ramps over 1023 * 1023. Return the length in periods, or 0 if from == to
+static inline uint32_t pwm_fade_plan(uint32_t from, uint32_t to,
+                                     uint32_t periods, uint32_t *start,
+                                     uint32_t *num, uint32_t *scale,
+                                     uint32_t *cycles) {
+  uint32_t diff = to > from ? to - from : from - to;
+  if (diff == 0) return 0;
+  *scale = (diff + 1022) / 1023;
+  if (*scale > 1023) *scale = 1023;
+  *num = diff / *scale;
+  if (*num > 1023) *num = 1023;
+  *cycles = periods / *num;
+  if (*cycles < 1) *cycles = 1;
+  if (*cycles > 1023) *cycles = 1023;
+  *start = to > from ? to - *num * *scale : to + *num * *scale;
+  return *num * *cycles;
+}
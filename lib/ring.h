@@ -0,0 +1,64 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// Lock-free single producer, single consumer ring buffer. One side may run
+// on another core or in an interrupt handler. Architecture independent,
+// builds on a workstation too
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+struct ring {
+  uint8_t *buf;   // Storage
+  uint32_t size;  // Storage size, must be a power of 2
+  uint32_t head;  // Total bytes written. Changed by producer only
+  uint32_t tail;  // Total bytes read. Changed by consumer only
+};
+
+static inline bool ring_init(struct ring *r, void *buf, size_t size) {
+  if (size == 0 || (size & (size - 1)) || size > 0x80000000U) return false;
+  r->buf = (uint8_t *) buf, r->size = (uint32_t) size, r->head = r->tail = 0;
+  return true;
+}
+
+// Number of bytes available for reading
+static inline size_t ring_used(struct ring *r) {
+  return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) -
+         __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+}
+
+// Copy `len` bytes between `buf` and the ring, starting at offset `pos`
+static inline void ring_copy(struct ring *r, uint32_t pos, void *buf,
+                             size_t len, bool write) {
+  uint32_t ofs = pos & (r->size - 1), n = r->size - ofs;
+  if (n > len) n = (uint32_t) len;
+  if (write) {
+    memcpy(r->buf + ofs, buf, n);
+    memcpy(r->buf, (uint8_t *) buf + n, len - n);
+  } else {
+    memcpy(buf, r->buf + ofs, n);
+    memcpy((uint8_t *) buf + n, r->buf, len - n);
+  }
+}
+
+// Producer side. Write all `len` bytes, or nothing if there is no room
+static inline bool ring_write(struct ring *r, const void *buf, size_t len) {
+  uint32_t head = r->head, tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+  if (len > r->size - (head - tail)) return false;
+  ring_copy(r, head, (void *) buf, len, true);
+  __atomic_store_n(&r->head, head + (uint32_t) len, __ATOMIC_RELEASE);
+  return true;
+}
+
+// Consumer side. Read all `len` bytes, or nothing if there is not enough
+static inline bool ring_read(struct ring *r, void *buf, size_t len) {
+  uint32_t tail = r->tail, head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+  if (len > head - tail) return false;
+  ring_copy(r, tail, buf, len, false);
+  __atomic_store_n(&r->tail, tail + (uint32_t) len, __ATOMIC_RELEASE);
+  return true;
+}
@@ -0,0 +1,42 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// WS2812 helpers shared by the parallel output drivers of esp32 and esp32c3.
+// Architecture independent, builds on a workstation too
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Transpose bits of byte `i` of up to 16 strips into 8 bit planes, MSB first:
+// bit `s` of planes[k] is bit (7 - k) of bufs[s][i]. Hacker's Delight 7-3
+static inline void ws2812_transpose(uint16_t planes[8],
+                                    const uint8_t *const *bufs, int n,
+                                    size_t i) {
+  for (int k = 0; k < 8; k++) planes[k] = 0;
+  for (int base = 0; base < n; base += 8) {
+    uint32_t x = 0, y = 0, t;
+    for (int s = 0; s < 8 && base + s < n; s++) {
+      uint32_t v = bufs[base + s][i];  // Strip s goes to row 7 - s
+      if (s < 4) y |= v << (s * 8);
+      else x |= v << ((s - 4) * 8);
+    }
+    t = (x ^ (x >> 7)) & 0x00aa00aaU, x = x ^ t ^ (t << 7);
+    t = (y ^ (y >> 7)) & 0x00aa00aaU, y = y ^ t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000ccccU, x = x ^ t ^ (t << 14);
+    t = (y ^ (y >> 14)) & 0x0000ccccU, y = y ^ t ^ (t << 14);
+    t = (x & 0xf0f0f0f0U) | ((y >> 4) & 0x0f0f0f0fU);
+    y = ((x << 4) & 0xf0f0f0f0U) | (y & 0x0f0f0f0fU);
+    for (int k = 0; k < 4; k++) {
+      planes[k] |= (uint16_t) (((t >> (24 - k * 8)) & 255) << base);
+      planes[k + 4] |= (uint16_t) (((y >> (24 - k * 8)) & 255) << base);
+    }
+  }
+}
+
+// Frames per second achievable for strips of `leds` LEDs: 24 bits of
+// 1.25 us each per LED, plus 300 us reset. Same for any number of strips
+static inline unsigned long ws2812_fps(size_t leds) {
+  return 1000000UL / (unsigned long) (leds * 30 + 300);
+}
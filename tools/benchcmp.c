@@ -0,0 +1,105 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// Compare two runs of examples/bench. Input files are captured console
+// output: lines that are not bench JSON results are ignored. Results in
+// "KB/s" are better when higher, all others when lower. Exit code is 1 if
+// any result is worse than the threshold
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_RESULTS 256
+
+struct result {
+  char arch[16], name[48], unit[16];
+  double value;
+};
+
+static int fail(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  exit(EXIT_FAILURE);
+}
+
+// Copy string value of "key" from a JSON line. Return 0 if not found
+static int getstr(const char *line, const char *key, char *buf, size_t len) {
+  char pattern[32];
+  const char *p, *end;
+  snprintf(pattern, sizeof(pattern), "\"%s\":\"", key);
+  if ((p = strstr(line, pattern)) == NULL) return 0;
+  p += strlen(pattern);
+  if ((end = strchr(p, '"')) == NULL || (size_t) (end - p) >= len) return 0;
+  memcpy(buf, p, (size_t) (end - p));
+  buf[end - p] = '\0';
+  return 1;
+}
+
+static int load(const char *path, struct result *r, int max) {
+  char line[512];
+  int n = 0;
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) fail("cannot open %s\n", path);
+  while (n < max && fgets(line, sizeof(line), fp) != NULL) {
+    const char *v = strstr(line, "\"value\":");
+    if (line[0] != '{' || v == NULL) continue;
+    if (!getstr(line, "arch", r[n].arch, sizeof(r[n].arch)) ||
+        !getstr(line, "name", r[n].name, sizeof(r[n].name)) ||
+        !getstr(line, "unit", r[n].unit, sizeof(r[n].unit)))
+      continue;
+    if (strcmp(r[n].name, "done") == 0) continue;
+    r[n].value = strtod(v + 8, NULL);
+    n++;
+  }
+  fclose(fp);
+  return n;
+}
+
+int main(int argc, char **argv) {
+  static struct result a[MAX_RESULTS], b[MAX_RESULTS];
+  double threshold = 10;  // Percent
+  int i, na, nb, worse = 0;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      threshold = atof(argv[++i]);
+    } else {
+      break;
+    }
+  }
+  if (argc - i != 2) {
+    return fail(
+        "Usage: %s [OPTIONS] BASELINE CURRENT\n"
+        "  -t PERCENT\t - regression threshold. Default: %g\n"
+        "BASELINE and CURRENT are logs of examples/bench runs, e.g.\n"
+        "  make -C examples/bench build flash monitor | tee esp32c3.log\n",
+        argv[0], threshold);
+  }
+  na = load(argv[i], a, MAX_RESULTS);
+  nb = load(argv[i + 1], b, MAX_RESULTS);
+  printf("%-24s %12s %12s %9s  %s vs %s\n", "name", "baseline", "current",
+         "delta", na > 0 ? a[0].arch : "?", nb > 0 ? b[0].arch : "?");
+  for (int j = 0; j < nb; j++) {
+    const struct result *old = NULL;
+    double delta;
+    int higher = strcmp(b[j].unit, "KB/s") == 0, bad;
+    for (int k = 0; k < na && old == NULL; k++) {
+      if (strcmp(a[k].name, b[j].name) == 0) old = &a[k];
+    }
+    if (old == NULL) {
+      printf("%-24s %12s %12.0f %9s  %s\n", b[j].name, "-", b[j].value, "-",
+             b[j].unit);
+      continue;
+    }
+    delta = old->value == 0 ? 0 : (b[j].value - old->value) * 100 / old->value;
+    bad = higher ? delta < -threshold : delta > threshold;
+    printf("%-24s %12.0f %12.0f %+8.1f%%  %s%s\n", b[j].name, old->value,
+           b[j].value, delta, b[j].unit, bad ? "  WORSE" : "");
+    worse += bad;
+  }
+  return worse > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
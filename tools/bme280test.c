@@ -0,0 +1,157 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// Check lib/bme280.h compensation against the BMP280 datasheet example,
+// 3.12: T = 25.08 C, t_fine = 128422, P = 100653 Pa. Humidity has no
+// datasheet example: check it, and a grid of other readings, against the
+// datasheet floating point formulas, BME280 datasheet 8.1. Then read a
+// sample via bme280_init() and bme280_read() from an emulated sensor, which
+// starts copying calibration from NVM only 1 ms after a soft reset
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bme280.h"
+
+// Datasheet calibration for T and P. Humidity values are from a real sensor
+static const int16_t s_tp[12] = {
+    27504, 26435, -1000,                                        // T1 .. T3
+    -29059, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000};  // P1 36477
+static const uint8_t s_h[7] = {362 & 255, 362 >> 8, 0, 313 >> 4,  // H2 .. H4
+                               (313 & 15) | (0xfce & 15) << 4,    // H4, H5
+                               0xfce >> 4, 30};                   // H5, H6
+static uint8_t s_regs[256];           // Emulated sensor registers
+static uint8_t s_nvm[256];            // Calibration, copied after reset
+static unsigned long s_ms;            // Virtual time, advanced by delay()
+static unsigned long s_reset = ~0UL;  // When the last soft reset was
+static double s_t_fine;               // Floating point t_fine
+
+static int fail(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  exit(EXIT_FAILURE);
+}
+
+static double temp(const struct bme280_calib *c, double adc) {
+  double v1 = (adc / 16384.0 - c->t1 / 1024.0) * c->t2;
+  double v2 = (adc / 131072.0 - c->t1 / 8192.0) *
+              (adc / 131072.0 - c->t1 / 8192.0) * c->t3;
+  s_t_fine = v1 + v2;
+  return (v1 + v2) / 5120.0;
+}
+
+static double pressure(const struct bme280_calib *c, double adc) {
+  double v1 = s_t_fine / 2.0 - 64000.0, v2 = v1 * v1 * c->p6 / 32768.0, p;
+  v2 = v2 + v1 * c->p5 * 2.0;
+  v2 = v2 / 4.0 + c->p4 * 65536.0;
+  v1 = (c->p3 * v1 * v1 / 524288.0 + c->p2 * v1) / 524288.0;
+  v1 = (1.0 + v1 / 32768.0) * c->p1;
+  p = (1048576.0 - adc - v2 / 4096.0) * 6250.0 / v1;
+  v1 = c->p9 * p * p / 2147483648.0;
+  v2 = p * c->p8 / 32768.0;
+  return p + (v1 + v2 + c->p7) / 16.0;
+}
+
+static double humidity(const struct bme280_calib *c, double adc) {
+  double h = s_t_fine - 76800.0;
+  h = (adc - (c->h4 * 64.0 + c->h5 / 16384.0 * h)) *
+      (c->h2 / 65536.0 *
+       (1.0 + c->h6 / 67108864.0 * h * (1.0 + c->h3 / 67108864.0 * h)));
+  h = h * (1.0 - c->h1 * h / 524288.0);
+  return h > 100.0 ? 100.0 : h < 0.0 ? 0.0 : h;
+}
+
+// After a soft reset, status im_update is 0 for 1 ms, then 1 for 1 ms while
+// the calibration is copied from NVM. Calibration registers are 0 until then
+static bool reg_read(void *ctx, uint8_t reg, uint8_t *buf, size_t len) {
+  unsigned long elapsed = s_ms - s_reset;
+  (void) ctx;
+  if (s_reset != ~0UL && elapsed >= 2) {
+    memcpy(&s_regs[0x88], &s_nvm[0x88], 26);
+    memcpy(&s_regs[0xe1], &s_nvm[0xe1], 7);
+    s_reset = ~0UL;
+  }
+  s_regs[0xf3] = s_reset != ~0UL && elapsed == 1 ? 1 : 0;
+  memcpy(buf, &s_regs[reg], len);
+  return true;
+}
+
+static bool reg_write(void *ctx, uint8_t reg, uint8_t val) {
+  (void) ctx;
+  if (reg == 0xe0 && val == 0xb6) {  // Soft reset: calibration is lost
+    memset(&s_regs[0x88], 0, 26);
+    memset(&s_regs[0xe1], 0, 7);
+    s_reset = s_ms;
+  } else {
+    s_regs[reg] = val;
+  }
+  return true;
+}
+
+static void delay(unsigned long ms) {
+  s_ms += ms;
+}
+
+int main(void) {
+  struct bme280_calib c;
+  struct bme280 dev = {reg_read, reg_write, delay, NULL, 0, {0}};
+  struct bme280_data d;
+  uint8_t tp[26] = {0};
+  int32_t t, t_fine;
+  uint32_t p;
+  int checked = 0;
+
+  for (int i = 0; i < 12; i++) {
+    tp[2 * i] = (uint8_t) s_tp[i], tp[2 * i + 1] = (uint8_t) (s_tp[i] >> 8);
+  }
+  tp[25] = 75;  // H1
+  bme280_parse_calib(&c, tp, s_h);
+  if (c.p1 != 36477 || c.h4 != 313 || c.h5 != -50 || c.h6 != 30)
+    fail("calibration: P1 %u H4 %d H5 %d H6 %d\n", c.p1, c.h4, c.h5, c.h6);
+
+  // Datasheet example: adc_T 519888, adc_P 415148
+  t = bme280_temp(&c, 519888, &t_fine);
+  p = bme280_pressure(&c, 415148, t_fine);
+  if (t != 2508) fail("T: %d, expected 2508\n", t);
+  if (t_fine != 128422) fail("t_fine: %d, expected 128422\n", t_fine);
+  if (p / 256 != 100653) fail("P: %u Pa, expected 100653\n", p / 256);
+
+  // Integer code against floating point, over a range of readings
+  for (int32_t at = 400000; at < 600000; at += 997) {
+    double td = temp(&c, at);
+    t = bme280_temp(&c, at, &t_fine);
+    if (fabs(t / 100.0 - td) > 0.011) fail("T(%d): %d, %f\n", at, t, td);
+    for (int32_t ap = 250000; ap < 500000; ap += 4999, checked++) {
+      double pd = pressure(&c, ap);
+      p = bme280_pressure(&c, ap, t_fine);
+      if (fabs(p / 256.0 - pd) > 1.0) fail("P(%d): %u, %f\n", ap, p, pd);
+    }
+    for (int32_t ah = 20000; ah < 40000; ah += 701, checked++) {
+      double hd = humidity(&c, ah);
+      uint32_t h = bme280_humidity(&c, ah, t_fine);
+      if (fabs(h / 1024.0 - hd) > 0.05) fail("H(%d): %u, %f\n", ah, h, hd);
+    }
+  }
+
+  // Whole driver: calibration and a sample via the register callbacks
+  memcpy(&s_nvm[0x88], tp, sizeof(tp));
+  memcpy(&s_nvm[0xe1], s_h, sizeof(s_h));
+  s_regs[0xd0] = BME280_ID;
+  s_regs[0xf7] = 0x65, s_regs[0xf8] = 0x5a, s_regs[0xf9] = 0xc0;  // P
+  s_regs[0xfa] = 0x7e, s_regs[0xfb] = 0xed, s_regs[0xfc] = 0x00;  // T
+  s_regs[0xfd] = 0x6f, s_regs[0xfe] = 0x28;                       // H
+  if (!bme280_init(&dev) || !bme280_read(&dev, &d)) fail("driver failed\n");
+  if (d.temp != 2508 || d.pressure / 256 != 100653)
+    fail("driver: T %d, P %u\n", d.temp, d.pressure / 256);
+  temp(&c, 519888);
+  if (fabs(d.humidity / 1024.0 - humidity(&c, 0x6f28)) > 0.05)
+    fail("driver: H %u\n", d.humidity);
+
+  printf("bme280test: datasheet example and %d readings match\n", checked);
+  return EXIT_SUCCESS;
+}
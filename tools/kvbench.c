@@ -0,0 +1,254 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// Run a random workload against the key/value store on a file-backed NOR
+// flash emulator: writes can only clear bits, erase sets a sector to 0xff.
+// Report write amplification and wear, and check results against a model.
+// With -p, cut power at a random byte of a flash write or erase, remount,
+// and check that every key holds either its old or its new value.
+// A check that a full index does not break the store runs first
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kv.h"
+
+#define SECTOR_SIZE 4096
+#define MAX_SECTORS 256
+#define MAX_KEYS 256
+
+static FILE *s_fp;                      // Flash image
+static uint32_t s_erases[MAX_SECTORS];  // Per-sector erase counters
+static uint8_t s_model[MAX_KEYS][256];  // Expected values
+static int s_model_len[MAX_KEYS];       // Expected lengths, -1 if deleted
+static int s_pending = -1;              // Key being changed, or -1
+static uint8_t s_old[256];              // Value of s_pending before change
+static int s_old_len;                   // Its length, -1 if deleted
+static bool s_rolled_back;              // check() found the old value
+static long s_budget = -1;              // Bytes until power is cut, or -1
+static jmp_buf s_power;                 // Where to go when power is cut
+
+static int fail(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  exit(EXIT_FAILURE);
+}
+
+static bool aligned(uint32_t addr, const void *buf, size_t len) {
+  return addr % 4 == 0 && len % 4 == 0 && (uintptr_t) buf % 4 == 0;
+}
+
+static bool flash_read(uint32_t addr, void *buf, size_t len) {
+  if (!aligned(addr, buf, len)) fail("unaligned read %#x %zu\n", addr, len);
+  fseek(s_fp, (long) addr, SEEK_SET);
+  return fread(buf, 1, len, s_fp) == len;
+}
+
+// Spend the power budget on `len` bytes. Return how many get done
+static size_t power(size_t len) {
+  size_t n = s_budget < 0 || (size_t) s_budget >= len ? len : (size_t) s_budget;
+  if (s_budget >= 0) s_budget -= (long) n;
+  return n;
+}
+
+static bool flash_write(uint32_t addr, const void *buf, size_t len) {
+  uint8_t tmp[SECTOR_SIZE];
+  const uint8_t *p = (const uint8_t *) buf;
+  size_t n = power(len);
+  if (!aligned(addr, buf, len) || len > sizeof(tmp))
+    fail("unaligned write %#x %zu\n", addr, len);
+  if (!flash_read(addr, tmp, len)) return false;
+  for (size_t i = 0; i < n; i++) tmp[i] &= p[i];  // NOR: 1 -> 0 only
+  fseek(s_fp, (long) addr, SEEK_SET);
+  if (fwrite(tmp, 1, len, s_fp) != len) return false;
+  if (n < len) longjmp(s_power, 1);  // Power cut, the write is torn
+  return true;
+}
+
+static bool flash_erase(uint32_t addr) {
+  uint8_t tmp[SECTOR_SIZE];
+  size_t n = power(sizeof(tmp));
+  if (addr % SECTOR_SIZE) fail("unaligned erase %#x\n", addr);
+  s_erases[addr / SECTOR_SIZE]++;
+  memset(tmp, 0xff, sizeof(tmp));
+  fseek(s_fp, (long) addr, SEEK_SET);
+  if (fwrite(tmp, 1, n, s_fp) != n) return false;
+  if (n < sizeof(tmp)) longjmp(s_power, 1);  // Power cut, partly erased
+  return true;
+}
+
+static bool matches(const uint8_t *buf, int n, const uint8_t *val, int len) {
+  return n == len && (n <= 0 || memcmp(buf, val, (size_t) n) == 0);
+}
+
+static void check(struct kv *kv, int keys) {
+  uint8_t buf[256];
+  char key[16];
+  for (int i = 0; i < keys; i++) {
+    snprintf(key, sizeof(key), "key%d", i);
+    int n = kv_get(kv, key, buf, sizeof(buf));
+    if (matches(buf, n, s_model[i], s_model_len[i])) continue;
+    if (i == s_pending && matches(buf, n, s_old, s_old_len)) {
+      memcpy(s_model[i], s_old, sizeof(s_old));  // Change did not commit
+      s_model_len[i] = s_old_len, s_rolled_back = true;
+      continue;
+    }
+    fail("%s: got %d, expected %d\n", key, n, s_model_len[i]);
+  }
+}
+
+// Do a random set or delete, then a GC step. Return user bytes written.
+// The model gets the new value first, s_old keeps the old one
+static uint32_t op(struct kv *kv, int keys, int vmax, int i) {
+  int k = rand() % keys, len = rand() % (vmax + 1);
+  uint32_t user = 0;
+  char key[16];
+  snprintf(key, sizeof(key), "key%d", k);
+  s_pending = k, s_old_len = s_model_len[k];
+  memcpy(s_old, s_model[k], sizeof(s_old));
+  if (rand() % 10 == 0) {
+    s_model_len[k] = -1;
+    if (!kv_del(kv, key)) fail("%d: del %s failed\n", i, key);
+  } else {
+    for (int j = 0; j < len; j++) s_model[k][j] = (uint8_t) rand();
+    s_model_len[k] = len;
+    if (!kv_set(kv, key, s_model[k], (size_t) len))
+      fail("%d: set %s failed\n", i, key);
+    user += (uint32_t) (strlen(key) + (size_t) len);
+  }
+  s_pending = -1;
+  kv_gc(kv, 1);
+  return user;
+}
+
+// Run the workload until power is cut at a random byte. Return total
+// number of operations started
+static int run_until_cut(struct kv *kv, int keys, int vmax) {
+  static int ops;
+  s_budget = rand() % (4 * SECTOR_SIZE);
+  if (setjmp(s_power) == 0) {
+    for (;;) op(kv, keys, vmax, ops++);
+  }
+  s_budget = -1;
+  return ops;
+}
+
+// Cut power `cuts` times, remount, and check all keys after each cut
+static void power_loss(struct kv *kv, int keys, int vmax, int cuts) {
+  int ops = 0, changes = 0, rolled_back = 0;
+  for (int c = 0; c < cuts; c++) {
+    ops = run_until_cut(kv, keys, vmax);
+    if (!kv_open(kv)) fail("cut %d: kv_open failed\n", c);
+    s_rolled_back = false;
+    check(kv, keys);
+    if (s_pending >= 0) changes++, rolled_back += s_rolled_back;
+    s_pending = -1;
+  }
+  printf("power cuts: %d, operations: %d, keys: %u\n", cuts, ops, kv->count);
+  printf("cuts during a change: %d, rolled back: %d, committed: %d\n",
+         changes, rolled_back, changes - rolled_back);
+}
+
+// Fill a small index. A key that does not fit must be refused before it
+// reaches flash, and the store must mount again, even with a smaller index
+static void index_full(void) {
+  struct kv_slot index[8];
+  struct kv kv = {flash_read, flash_write, flash_erase, 0, SECTOR_SIZE,
+                  4, index, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+  char key[16];
+  uint32_t written;
+  for (int i = 0; i < 4; i++) flash_erase((uint32_t) i * SECTOR_SIZE);
+  if (!kv_open(&kv)) fail("index: kv_open failed\n");
+  for (int i = 0; i < 6; i++) {
+    snprintf(key, sizeof(key), "k%d", i);
+    if (!kv_set(&kv, key, key, strlen(key)))
+      fail("index: set %s failed\n", key);
+  }
+  written = kv.written;
+  if (kv_set(&kv, "k6", "k6", 2)) fail("index: k6 set, index is full\n");
+  if (kv.written != written) fail("index: refused k6 reached flash\n");
+  if (!kv_set(&kv, "k0", "new", 3)) fail("index: update k0 failed\n");
+  if (!kv_open(&kv) || kv.count != 6) fail("index: remount failed\n");
+  if (kv_get(&kv, "k0", key, sizeof(key)) != 3 ||
+      kv_get(&kv, "k6", key, sizeof(key)) >= 0)
+    fail("index: wrong values after remount\n");
+  if (!kv_del(&kv, "k1") || !kv_set(&kv, "k6", "k6", 2))
+    fail("index: set after delete failed\n");
+  kv.index_size = 4;  // Mount with a smaller index: keys are lost, no error
+  if (!kv_open(&kv) || kv.count != 3) fail("index: small remount failed\n");
+}
+
+int main(int argc, char **argv) {
+  const char *path = "kvbench.bin";
+  int sectors = 16, keys = 64, iterations = 100000, vmax = 64, cuts = 0;
+  uint32_t user = 0, min = ~0U, max = 0;
+  struct kv_slot index[2 * MAX_KEYS];
+  struct kv kv = {flash_read, flash_write, flash_erase, 0, SECTOR_SIZE,
+                  0, index, 2 * MAX_KEYS, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      path = argv[++i];
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      sectors = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+      keys = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc) {
+      vmax = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      cuts = atoi(argv[++i]);
+    } else {
+      return fail(
+          "Usage: %s [OPTIONS]\n"
+          "  -f FILE\t - flash image file. Default: %s\n"
+          "  -s NUM\t - number of %d byte sectors. Default: %d\n"
+          "  -k NUM\t - number of keys. Default: %d\n"
+          "  -n NUM\t - number of operations. Default: %d\n"
+          "  -v NUM\t - max value size. Default: %d\n"
+          "  -p NUM\t - instead, cut power NUM times at random, remount\n"
+          "\t\t   and check that each key has its old or new value\n",
+          argv[0], path, SECTOR_SIZE, sectors, keys, iterations, vmax);
+    }
+  }
+  if (sectors < 4 || sectors > MAX_SECTORS) fail("bad sector count\n");
+  if (keys < 1 || keys > MAX_KEYS) fail("bad key count\n");
+  if (vmax < 1 || vmax > 255) fail("bad value size\n");
+  if ((s_fp = fopen(path, "w+b")) == NULL) fail("cannot open %s\n", path);
+  index_full();
+  kv.sectors = (uint32_t) sectors;
+  for (int i = 0; i < sectors; i++) flash_erase((uint32_t) i * SECTOR_SIZE);
+  memset(s_erases, 0, sizeof(s_erases));
+  for (int i = 0; i < keys; i++) s_model_len[i] = -1;
+  if (!kv_open(&kv)) fail("kv_open failed\n");
+
+  srand(1);
+  if (cuts > 0) {
+    power_loss(&kv, keys, vmax, cuts);
+    fclose(s_fp);
+    return 0;
+  }
+  for (int i = 0; i < iterations; i++) {
+    user += op(&kv, keys, vmax, i);
+    if (i % 1000 == 0) check(&kv, keys);
+  }
+  check(&kv, keys);
+  for (int i = 0; i < sectors; i++) {
+    if (s_erases[i] < min) min = s_erases[i];
+    if (s_erases[i] > max) max = s_erases[i];
+  }
+  printf("operations: %d, keys: %u\n", iterations, kv.count);
+  printf("user bytes: %u, flash bytes: %u, amplification: %.2f\n", user,
+         kv.written, user ? (double) kv.written / user : 0.0);
+  printf("erases: %u, per sector min %u max %u\n", kv.erased, min, max);
+  if (!kv_open(&kv)) fail("kv_open failed\n");  // Remount and re-check
+  check(&kv, keys);
+  fclose(s_fp);
+  return 0;
+}
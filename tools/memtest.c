@@ -0,0 +1,97 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// Check lib/mem.h against libc: random sizes, source and destination
+// alignments, and overlapping moves in both directions. Whole buffers are
+// compared, so a write outside of the range shows up too. Copies also run
+// on exactly sized heap buffers, so that -fsanitize=address catches any
+// access past the ends
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+
+#define SIZE 600  // Test buffers
+
+static int fail(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  exit(EXIT_FAILURE);
+}
+
+static int sign(int x) {
+  return x < 0 ? -1 : x > 0 ? 1 : 0;
+}
+
+static void randomize(uint8_t *buf, size_t len) {
+  for (size_t i = 0; i < len; i++) buf[i] = (uint8_t) rand();
+}
+
+// Random operation on `got` with lib/mem.h, and on `want` with libc
+static void check_random(long iteration) {
+  static uint8_t src[SIZE], got[SIZE], want[SIZE];
+  size_t n = (size_t) rand() % (iteration % 10 == 0 ? 520 : 40);  // Size
+  size_t so = (size_t) rand() % 40, doff = (size_t) rand() % 40;  // Offsets
+  int op = rand() % 4;
+  randomize(src, sizeof(src));
+  randomize(got, sizeof(got));
+  memcpy(want, got, sizeof(want));
+  if (op == 0) {
+    if (mem_copy(got + doff, src + so, n) != got + doff) fail("copy ret\n");
+    memcpy(want + doff, src + so, n);
+  } else if (op == 1) {
+    int c = rand();
+    if (mem_fill(got + doff, c, n) != got + doff) fail("fill ret\n");
+    memset(want + doff, c, n);
+  } else if (op == 2) {  // Overlaps either way, or not at all
+    size_t from = (size_t) rand() % 80, to = (size_t) rand() % 80;
+    if (mem_move(got + to, got + from, n) != got + to) fail("move ret\n");
+    memmove(want + to, want + from, n);
+  } else {
+    if (n > 0 && rand() % 2) got[doff + (size_t) rand() % n] ^= 0x5a;
+    if (sign(mem_compare(got + doff, want + doff, n)) !=
+        sign(memcmp(got + doff, want + doff, n)))
+      fail("%ld: compare n=%zu off=%zu\n", iteration, n, doff);
+    memcpy(got, want, sizeof(got));
+  }
+  if (memcmp(got, want, sizeof(got)) != 0)
+    fail("%ld: op %d n=%zu src+%zu dst+%zu\n", iteration, op, n, so, doff);
+}
+
+// Buffers of exactly n + offset bytes on the heap, for the sanitizer
+static void check_bounds(size_t n, size_t so, size_t doff) {
+  uint8_t *src = (uint8_t *) malloc(n + so);
+  uint8_t *dst = (uint8_t *) malloc(n + doff);
+  if (src == NULL || dst == NULL) fail("out of memory\n");
+  randomize(src, n + so);
+  mem_copy(dst + doff, src + so, n);
+  if (memcmp(dst + doff, src + so, n) != 0) fail("copy %zu\n", n);
+  if (mem_compare(dst + doff, src + so, n) != 0) fail("compare %zu\n", n);
+  mem_fill(dst + doff, 0xa5, n);
+  mem_move(dst + doff, src + so, n);
+  if (memcmp(dst + doff, src + so, n) != 0) fail("move %zu\n", n);
+  if (n > 1) {
+    mem_move(dst + doff + 1, dst + doff, n - 1);  // Overlap, backward
+    mem_move(dst + doff, dst + doff + 1, n - 1);  // Overlap, forward
+  }
+  free(src);
+  free(dst);
+}
+
+int main(int argc, char **argv) {
+  long iterations = argc > 1 ? atol(argv[1]) : 500000;
+  srand(5);
+  for (long i = 0; i < iterations; i++) check_random(i);
+  for (size_t n = 0; n < 100; n++) {
+    for (size_t so = 0; so < 4; so++) {
+      for (size_t doff = 0; doff < 4; doff++) check_bounds(n, so, doff);
+    }
+  }
+  printf("memtest: %ld random operations match libc\n", iterations);
+  return EXIT_SUCCESS;
+}
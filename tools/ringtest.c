@@ -0,0 +1,78 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// Stress test of the lock-free ring buffer, lib/ring.h: a producer and a
+// consumer thread pass sequence numbers in records of random length through
+// a small ring, so that it wraps and fills up all the time. The consumer
+// checks that every number arrives once, in order
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ring.h"
+
+#define MAX_RECORD 7  // Sequence numbers per record, at most
+
+static struct ring s_ring;
+static uint32_t s_buf[16];  // 64 bytes: a record fills up to half of it
+static unsigned long s_count = 1000000;
+
+static int fail(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  exit(EXIT_FAILURE);
+}
+
+static void *producer(void *arg) {
+  uint32_t rec[MAX_RECORD], seq = 0, rnd = 1;
+  (void) arg;
+  while (seq < s_count) {
+    size_t n;
+    rnd = rnd * 1103515245U + 12345U;
+    n = 1 + (rnd >> 16) % MAX_RECORD;
+    if (n > s_count - seq) n = s_count - seq;
+    for (size_t i = 0; i < n; i++) rec[i] = seq + (uint32_t) i;
+    while (!ring_write(&s_ring, rec, n * sizeof(rec[0]))) sched_yield();
+    seq += (uint32_t) n;
+  }
+  return NULL;
+}
+
+static void *consumer(void *arg) {
+  uint32_t rec[MAX_RECORD], seq = 0, rnd = 7;
+  (void) arg;
+  while (seq < s_count) {
+    size_t n, used = ring_used(&s_ring);
+    rnd = rnd * 1103515245U + 12345U;
+    n = 1 + (rnd >> 16) % MAX_RECORD;  // Independent of record boundaries
+    if (n > s_count - seq) n = s_count - seq;
+    if (used > sizeof(s_buf) || used % sizeof(rec[0]) != 0)
+      fail("ring_used() returned %zu\n", used);
+    if (!ring_read(&s_ring, rec, n * sizeof(rec[0]))) {
+      sched_yield();  // Let the producer run on a single CPU host
+      continue;
+    }
+    for (size_t i = 0; i < n; i++, seq++) {
+      if (rec[i] != seq) fail("expected %u, got %u\n", seq, rec[i]);
+    }
+  }
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  pthread_t p, c;
+  if (argc > 1) s_count = strtoul(argv[1], NULL, 0);
+  ring_init(&s_ring, s_buf, sizeof(s_buf));
+  pthread_create(&c, NULL, consumer, NULL);
+  pthread_create(&p, NULL, producer, NULL);
+  pthread_join(p, NULL);
+  pthread_join(c, NULL);
+  if (ring_used(&s_ring) != 0) fail("ring is not empty at the end\n");
+  printf("ringtest: %lu numbers passed in order\n", s_count);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,284 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// Memory footprint report from a GNU ld map file: usage of each MEMORY
+// region, .bss size, free heap from _end to _eram, top symbols and per-file
+// contributions. Optionally show changes against a previous map, and check
+// region budgets.
+// Build firmware with -ffunction-sections -fdata-sections, so that input
+// sections map to functions and variables
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_REGIONS 16
+#define MAX_ENTRIES 8192
+
+struct region {
+  char name[32];
+  unsigned long origin, length, used, end;  // `end` - highest used address
+};
+
+struct entry {
+  char name[96];  // Symbol, or file name
+  const struct region *region;
+  long size;
+};
+
+struct map {
+  struct region regions[MAX_REGIONS];
+  struct entry syms[MAX_ENTRIES], files[MAX_ENTRIES];
+  int nregions, nsyms, nfiles;
+  unsigned long bss;        // Size of the .bss output section
+  unsigned long end, eram;  // Addresses of _end and _eram, 0 if not found
+};
+
+static int fail(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  exit(EXIT_FAILURE);
+}
+
+static struct region *find_region(struct map *m, unsigned long addr) {
+  for (int i = 0; i < m->nregions; i++) {
+    struct region *r = &m->regions[i];
+    if (addr >= r->origin && addr - r->origin < r->length) return r;
+  }
+  return NULL;
+}
+
+// Entries are keyed by name and region: a file can contribute to several
+static struct entry *find(struct entry *e, int n, const char *name,
+                          const char *region) {
+  for (int i = 0; i < n; i++) {
+    if (strcmp(e[i].name, name) == 0 &&
+        strcmp(e[i].region->name, region) == 0)
+      return &e[i];
+  }
+  return NULL;
+}
+
+static void add(struct entry *e, int *n, const char *name,
+                const struct region *r, long size) {
+  struct entry *p = find(e, *n, name, r->name);
+  if (p == NULL && *n < MAX_ENTRIES) {
+    p = &e[(*n)++];
+    snprintf(p->name, sizeof(p->name), "%s", name);
+    p->region = r, p->size = 0;
+  }
+  if (p != NULL) p->size += size;
+}
+
+// Symbol name from an input section name: ".text.main" -> "main"
+static const char *symbol(const char *section) {
+  const char *dot = section[0] == '.' ? strchr(section + 1, '.') : NULL;
+  return dot != NULL && dot[1] != '\0' ? dot + 1 : section;
+}
+
+static const char *basename_of(const char *path) {
+  const char *p = strrchr(path, '/');
+  return p == NULL ? path : p + 1;
+}
+
+// Account an input section: " .text.main 0x40380400 0x2c /path/main.o"
+static void input_section(struct map *m, const char *name, unsigned long addr,
+                          unsigned long size, const char *file) {
+  struct region *r = find_region(m, addr);
+  if (r == NULL || size == 0) return;
+  r->used += size;
+  if (addr + size > r->end) r->end = addr + size;
+  if (strcmp(name, "*fill*") == 0) return;
+  add(m->syms, &m->nsyms, symbol(name), r, (long) size);
+  add(m->files, &m->nfiles, basename_of(file), r, (long) size);
+}
+
+// Symbol assignment: "   0x3fc8840c   _end = ." or "PROVIDE (_end = .)"
+static void assignment(struct map *m, const char *line) {
+  char name[64];
+  unsigned long addr;
+  int n = 0;
+  if (sscanf(line, " 0x%lx %n", &addr, &n) != 1 || n == 0) return;
+  if (strncmp(line + n, "PROVIDE (", 9) == 0) n += 9;
+  if (sscanf(line + n, "%63[A-Za-z0-9_] =", name) != 1) return;
+  if (strcmp(name, "_end") == 0) m->end = addr;
+  if (strcmp(name, "_eram") == 0) m->eram = addr;
+}
+
+static void load(struct map *m, const char *path) {
+  char line[512], pending[256] = "", name[256], file[256], rname[32];
+  unsigned long origin, length, addr, size;
+  int state = 0;  // 0 - preamble, 1 - memory configuration, 2 - memory map
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) fail("cannot open %s\n", path);
+  memset(m, 0, sizeof(*m));
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (strncmp(line, "Memory Configuration", 20) == 0) {
+      state = 1;
+    } else if (strncmp(line, "Linker script and memory map", 28) == 0) {
+      state = 2;
+    } else if (state == 1 && m->nregions < MAX_REGIONS &&
+               sscanf(line, "%31s %lx %lx", rname, &origin, &length) == 3 &&
+               rname[0] != '*') {
+      struct region *r = &m->regions[m->nregions++];
+      memcpy(r->name, rname, sizeof(r->name));
+      r->origin = origin, r->length = length, r->end = origin;
+    } else if (state == 2 && line[0] == '.' &&
+               sscanf(line, "%255s %lx %lx", name, &addr, &size) == 3) {
+      if (strcmp(name, ".bss") == 0) m->bss += size;  // Output section
+    } else if (state == 2 && line[0] == ' ' && line[1] != ' ') {
+      // Input section. A long name is on its own line, the rest on the next
+      int n = sscanf(line, "%255s %lx %lx %255s", name, &addr, &size, file);
+      if (n == 1) snprintf(pending, sizeof(pending), "%s", name);
+      if (n == 4) input_section(m, name, addr, size, file), pending[0] = '\0';
+    } else if (state == 2 && pending[0] != '\0') {
+      if (sscanf(line, "%lx %lx %255s", &addr, &size, file) == 3)
+        input_section(m, pending, addr, size, file);
+      pending[0] = '\0';
+    } else if (state == 2) {
+      assignment(m, line);
+    }
+  }
+  fclose(fp);
+}
+
+static long size_of(const struct entry *e, int n, const struct entry *key) {
+  const struct entry *p =
+      find((struct entry *) e, n, key->name, key->region->name);
+  return p == NULL ? 0 : p->size;
+}
+
+static int by_size(const void *a, const void *b) {
+  long x = ((const struct entry *) a)->size;
+  long y = ((const struct entry *) b)->size;
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void print_delta(long delta, bool show) {
+  if (!show) {
+    printf("\n");
+  } else if (delta == 0) {
+    printf("%9s\n", "");
+  } else {
+    printf("%+9ld\n", delta);
+  }
+}
+
+static void top(const char *title, struct entry *e, int n, int count,
+                const struct entry *old, int nold, bool diff) {
+  qsort(e, (size_t) n, sizeof(*e), by_size);
+  printf("\n%-40s %-8s %8s", title, "region", "size");
+  printf(diff ? " %9s\n" : "\n", "delta");
+  for (int i = 0; i < n && i < count; i++) {
+    printf("%-40.40s %-8s %8ld", e[i].name, e[i].region->name, e[i].size);
+    print_delta(e[i].size - size_of(old, nold, &e[i]), diff);
+  }
+}
+
+int main(int argc, char **argv) {
+  static struct map cur, old;
+  const char *prev = NULL, *budgets[MAX_REGIONS];
+  int i, count = 10, nbudgets = 0, over = 0;
+  bool diff;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      count = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      prev = argv[++i];
+    } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc &&
+               nbudgets < MAX_REGIONS) {
+      budgets[nbudgets++] = argv[++i];
+    } else {
+      break;
+    }
+  }
+  if (argc - i != 1) {
+    return fail(
+        "Usage: %s [OPTIONS] MAPFILE\n"
+        "  -n NUM\t\t - number of top symbols and files. Default: %d\n"
+        "  -p MAPFILE\t - previous map file, show changes against it\n"
+        "  -b REGION=SIZE - fail if REGION uses more than SIZE bytes.\n"
+        "\t\t   SIZE can have a k suffix, e.g. -b iram=30k\n",
+        argv[0], count);
+  }
+  load(&cur, argv[i]);
+  if (cur.nregions == 0) fail("%s: no memory regions\n", argv[i]);
+  diff = prev != NULL;
+  if (diff) load(&old, prev);
+
+  printf("%-8s %10s %10s %10s %6s", "region", "origin", "used", "size",
+         "use");
+  printf(diff ? " %9s\n" : "\n", "delta");
+  for (int j = 0; j < cur.nregions; j++) {
+    const struct region *r = &cur.regions[j], *o = NULL;
+    if (r->used == 0) continue;
+    for (int k = 0; k < old.nregions && diff; k++) {
+      if (strcmp(old.regions[k].name, r->name) == 0) o = &old.regions[k];
+    }
+    printf("%-8s 0x%08lx %10lu %10lu %5lu%%", r->name, r->origin, r->used,
+           r->length, r->used * 100 / r->length);
+    print_delta((long) r->used - (long) (o == NULL ? 0 : o->used), diff);
+  }
+  printf("%-8s %10s %10lu", ".bss", "", cur.bss);
+  print_delta((long) cur.bss - (long) old.bss, diff);
+  if (cur.end != 0 && cur.eram > cur.end) {
+    long now = (long) (cur.eram - cur.end), was = 0;
+    if (old.end != 0 && old.eram > old.end) was = (long) (old.eram - old.end);
+    printf("heap: %ld bytes free from _end to _eram", now);
+    if (diff && was != 0 && was != now) printf(" (%+ld)", now - was);
+    printf("\n");
+  } else {
+    printf("heap: _end or _eram not found in the map\n");
+  }
+  top("symbol", cur.syms, cur.nsyms, count, old.syms, old.nsyms, diff);
+  top("file", cur.files, cur.nfiles, count, old.files, old.nfiles, diff);
+
+  if (diff) {  // Symbols that changed the most, including removed ones
+    struct entry changes[MAX_ENTRIES];
+    int n = 0;
+    for (int j = 0; j < cur.nsyms; j++) {
+      const struct entry *e = &cur.syms[j];
+      long d = e->size - size_of(old.syms, old.nsyms, e);
+      if (d != 0) changes[n] = cur.syms[j], changes[n++].size = labs(d);
+    }
+    for (int j = 0; j < old.nsyms && n < MAX_ENTRIES; j++) {
+      if (size_of(cur.syms, cur.nsyms, &old.syms[j]) == 0)
+        changes[n++] = old.syms[j];
+    }
+    qsort(changes, (size_t) n, sizeof(changes[0]), by_size);
+    printf("\n%-40s %-8s %8s %9s\n", "changed symbol", "region", "size",
+           "delta");
+    for (int j = 0; j < n && j < count; j++) {
+      long was = size_of(old.syms, old.nsyms, &changes[j]);
+      long now = size_of(cur.syms, cur.nsyms, &changes[j]);
+      printf("%-40.40s %-8s %8ld %+9ld\n", changes[j].name,
+             changes[j].region->name, now, now - was);
+    }
+  }
+
+  for (int j = 0; j < nbudgets; j++) {
+    char name[32], *eq = strchr(budgets[j], '='), *end;
+    unsigned long limit;
+    const struct region *r = NULL;
+    if (eq == NULL || (size_t) (eq - budgets[j]) >= sizeof(name))
+      fail("bad budget: %s\n", budgets[j]);
+    snprintf(name, sizeof(name), "%.*s", (int) (eq - budgets[j]), budgets[j]);
+    limit = strtoul(eq + 1, &end, 0);
+    if (*end == 'k' || *end == 'K') limit *= 1024;
+    for (int k = 0; k < cur.nregions; k++) {
+      if (strcmp(cur.regions[k].name, name) == 0) r = &cur.regions[k];
+    }
+    if (r == NULL) fail("budget: no region %s\n", name);
+    if (r->used > limit) {
+      printf("\n%s: %lu bytes used, over budget %lu by %lu\n", name, r->used,
+             limit, r->used - limit);
+      over++;
+    }
+  }
+  return over > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
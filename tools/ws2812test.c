@@ -0,0 +1,55 @@
+// Copyright (c) 2022 Cesanta
+// All rights reserved
+//
+// Check lib/ws2812.h bit plane transpose against a bit by bit reference:
+// bit s of plane k is bit (7 - k) of strip s, for every strip count from
+// 1 to 16, so partial groups of 8 strips are covered. Bits of strips that
+// do not exist must stay 0
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ws2812.h"
+
+#define STRIPS 16
+#define LEN 64
+
+static int fail(const char *fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  exit(EXIT_FAILURE);
+}
+
+int main(void) {
+  static uint8_t data[STRIPS][LEN];
+  const uint8_t *bufs[STRIPS];
+  uint16_t planes[8];
+  int checked = 0;
+
+  srand(1);
+  for (int s = 0; s < STRIPS; s++) {
+    for (int i = 0; i < LEN; i++) data[s][i] = (uint8_t) rand();
+    data[s][0] = 0xff, data[s][1] = 0, data[s][2] = (uint8_t) (1 << (s % 8));
+    bufs[s] = data[s];
+  }
+  for (int n = 1; n <= STRIPS; n++) {
+    for (size_t i = 0; i < LEN; i++) {
+      ws2812_transpose(planes, bufs, n, i);
+      for (int k = 0; k < 8; k++) {
+        for (int s = 0; s < STRIPS; s++, checked++) {
+          unsigned got = (planes[k] >> s) & 1U;
+          unsigned want = s < n ? (data[s][i] >> (7 - k)) & 1U : 0;
+          if (got != want)
+            fail("n %d, byte %zu, plane %d, strip %d: got %u, expected %u\n",
+                 n, i, k, s, got, want);
+        }
+      }
+    }
+  }
+  if (ws2812_fps(100) != 303) fail("fps: %lu\n", ws2812_fps(100));
+  printf("ws2812test: %d plane bits match\n", checked);
+  return EXIT_SUCCESS;
+}